@@ -18,83 +18,156 @@
 /* ------------------------------------------------------------------------- */
 
 
-#include <windows.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <vector>
+#include <chrono>
 #include "zpetri.hxx"
 #include "zpetri-env.hxx"
-#include "../../common/synprintf.hxx"
+#include "zpetri-channel.hxx"
 
 using namespace std;
 using namespace z;
 using namespace z::petri;
 
-//  
-struct queues_type
+//   
+const int width = 256;
+
+//   
+struct rules_type
+{
+    int id;
+    vector<double> weights;
+};
+// ,   
+struct state_type
+{
+    int id;
+    vector<double> values;
+};
+//  
+struct control_type
 {
-    // ...
+    int id;
+    double value;
 };
 
+//   : ,    id1, id2, id3,
+// rules, state  control,      ,
+//         
+typedef channel_type<int, spsc_queue_type<int> > idchannel_type;
+typedef channel_type<rules_type, spsc_queue_type<rules_type> >
+    ruleschannel_type;
+typedef channel_type<state_type, spsc_queue_type<state_type> >
+    statechannel_type;
+typedef channel_type<control_type, spsc_queue_type<control_type> >
+    controlchannel_type;
+
 //  
+class jobsplit_type: public threadenv_type::longjob_abstract_type
+{
+private:
+    channel_type<int> &m_id;
+    idchannel_type &m_id1, &m_id2, &m_id3;
+    void run(void)
+    {
+        int id = m_id.take();
+        m_id1.put(int(id));
+        m_id2.put(int(id));
+        m_id3.put(int(id));
+    }
+public:
+    jobsplit_type(channel_type<int> &id,
+        idchannel_type &id1, idchannel_type &id2, idchannel_type &id3):
+        m_id(id), m_id1(id1), m_id2(id2), m_id3(id3)
+    {}
+};
+
 class jobprepare_type: public threadenv_type::longjob_abstract_type
 {
 private:
-    queues_type &m_queues;
+    idchannel_type &m_id2;
+    ruleschannel_type &m_rules;
     void run(void)
     {
-        synprintf(stdout, "prepare begin\n");
-        // ...  
-        ::Sleep(200);
-        synprintf(stdout, "prepare end\n");
+        rules_type rules;
+        rules.id = m_id2.take();
+        rules.weights.resize(width);
+        for (int k = 0; k < width; ++k)
+            rules.weights[k] = 1.0 / (rules.id + k + 1);
+        m_rules.put(std::move(rules));
     }
 public:
-    jobprepare_type(queues_type &queues): m_queues(queues) {}
+    jobprepare_type(idchannel_type &id2, ruleschannel_type &rules):
+        m_id2(id2), m_rules(rules)
+    {}
 };
 
 class jobget_type: public threadenv_type::longjob_abstract_type
 {
-    // ...
 private:
-    queues_type &m_queues;
+    idchannel_type &m_id1;
+    statechannel_type &m_state;
     void run(void)
     {
-        synprintf(stdout, "get begin\n");
-        // ...  
-        ::Sleep(200);
-        synprintf(stdout, "get end\n");
+        state_type state;
+        state.id = m_id1.take();
+        state.values.resize(width);
+        for (int k = 0; k < width; ++k)
+            state.values[k] = state.id + k + 1;
+        m_state.put(std::move(state));
     }
 public:
-    jobget_type(queues_type &queues): m_queues(queues) {}
+    jobget_type(idchannel_type &id1, statechannel_type &state):
+        m_id1(id1), m_state(state)
+    {}
 };
 
 class jobprocess_type: public threadenv_type::longjob_abstract_type
 {
-    // ...
 private:
-    queues_type &m_queues;
+    statechannel_type &m_state;
+    ruleschannel_type &m_rules;
+    controlchannel_type &m_control;
     void run(void)
     {
-        synprintf(stdout, "process begin\n");
-        // ...  
-        ::Sleep(200);
-        synprintf(stdout, "process end\n");
+        //     ,  
+        //      
+        state_type state = m_state.take();
+        rules_type rules = m_rules.take();
+        assert(state.id == rules.id);
+        control_type control = { state.id, 0 };
+        for (int k = 0; k < width; ++k)
+            control.value += state.values[k] * rules.weights[k];
+        m_control.put(std::move(control));
     }
 public:
-    jobprocess_type(queues_type &queues): m_queues(queues) {}
+    jobprocess_type(statechannel_type &state, ruleschannel_type &rules,
+        controlchannel_type &control):
+        m_state(state), m_rules(rules), m_control(control)
+    {}
 };
 
 class jobpost_type: public threadenv_type::longjob_abstract_type
 {
-    // ...
 private:
-    queues_type &m_queues;
+    idchannel_type &m_id3;
+    controlchannel_type &m_control;
+    channel_type<double> &m_result;
     void run(void)
     {
-        synprintf(stdout, "post begin\n");
-        // ...  
-        ::Sleep(200);
-        synprintf(stdout, "post end\n");
+        int id = m_id3.take();
+        control_type control = m_control.take();
+        assert(id == control.id);
+        (void)id;
+        m_result.put(double(control.value));
     }
 public:
-    jobpost_type(queues_type &queues): m_queues(queues) {}
+    jobpost_type(idchannel_type &id3, controlchannel_type &control,
+        channel_type<double> &result):
+        m_id3(id3), m_control(control), m_result(result)
+    {}
 };
 
 
@@ -102,24 +175,29 @@ int main(int argc, char *argv[])
 {
     //~ srand(unsigned(time(NULL)));
 
-    const int n = 10;
+    const int n = argc > 1 ? atoi(argv[1]) : 10000;
+    if (n <= 0)
+        return 1;
 
-    //  
-    queues_type queues;
-    // ...    
+    // 
+    channel_type<int> id(n);
+    idchannel_type id1(n), id2(n), id3(n);
+    ruleschannel_type rules(n);
+    statechannel_type state(n);
+    controlchannel_type control(n);
+    channel_type<double> result(n);
+    place_type channel;
 
     //   
-    jobprepare_type jprepare(queues);
-    jobget_type jget(queues);
-    jobprocess_type jprocess(queues);
-    jobpost_type jpost(queues);
+    jobsplit_type jsplit(id, id1, id2, id3);
+    jobprepare_type jprepare(id2, rules);
+    jobget_type jget(id1, state);
+    jobprocess_type jprocess(state, rules, control);
+    jobpost_type jpost(id3, control, result);
 
     threadenv_type env;
-    // 
-    place_type id, id1, id2, id3;
-    place_type rules, state, control, result, channel;
     // 
-    transition_simple_type split;
+    threadenv_type::transition_long_type split(jsplit, env);
     threadenv_type::transition_long_type prepare(jprepare, env);
     threadenv_type::transition_long_type get(jget, env);
     threadenv_type::transition_long_type process(jprocess, env);
@@ -162,13 +240,27 @@ int main(int argc, char *argv[])
     content.add_arc(get, channel);
     content.add_arc(channel, post);
     content.add_arc(post, channel);
-    // 
+    // :   id    
+    for (int i = 0; i < n; ++i)
+        id.put(int(i));
     content.add_token(id, n);
     content.add_token(channel);
 
     //    
     petrinet_type petrinet(content);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
     petrinet.live(env);
+    double seconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+
+    //       ,  
+    int tokens = petrinet.get_tokens(&result);
+    assert(size_t(tokens) == result.size());
+    double total = 0;
+    for (int i = 0; i < tokens; ++i)
+        total += result.take();
+    printf("%d items, total %.6f, %.3f s, %.0f items/s\n",
+        tokens, total, seconds, tokens / seconds);
 
     return 0;
 }
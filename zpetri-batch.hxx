@@ -0,0 +1,485 @@
+/* ------------------------------------------------------------------------- */
+/*        ,                  */
+/*     :                              */
+/*   ..                                                             */
+/*    . - .: -, 2012. - 384 . */
+/*  ISBN 978-5-91359-102-9                                                   */
+/*                                                                           */
+/*     ,           */
+/*                   */
+/*   ,      .  */
+/*                   */
+/*  ,                 */
+/*       .                                     */
+/*     " ",            */
+/*         .       */
+/*                                                                           */
+/*  Copyright  2008-2011  ..                                       */
+/* ------------------------------------------------------------------------- */
+
+
+#ifndef _ZPETRI_BATCH_HXX_
+#define _ZPETRI_BATCH_HXX_
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cassert>
+#include "zpetri.hxx"
+#include "zpetri-flat.hxx"
+
+namespace z {
+namespace petri {
+
+//  :     
+//      ( randomenv_type)
+//      ,  
+//   :  
+//       
+//      
+//   ,   ;  k-
+//      ;
+//      ,   
+//    ,    
+// ,       
+class batch_type
+{
+public:
+    typedef std::map<transition_abstract_type *, long long> firedlist_type;
+
+    //  
+    struct report_type
+    {
+        //  
+        long long replications;
+        //  ,      
+        long long terminated;
+        // ,      
+        long long min_steps, max_steps;
+        double mean_steps;
+        //     
+        firedlist_type fired;
+        //    
+        double seconds;
+    };
+
+private:
+    typedef flatnet_type::arcmatrix_type arcmatrix_type;
+
+    //     (  
+    //  )
+    static const int blocksize = 32;
+
+    //  
+    flatnet_type m_net;
+
+    //  ,    (  -
+    // ,   ,      ,
+    //     )
+    struct result_type
+    {
+        long long terminated, min_steps, max_steps, sum_steps;
+        std::vector<long long> fired;
+    };
+
+    //    ( )
+    struct state_type
+    {
+        //      
+        std::vector<int> marking;
+        std::vector<unsigned char> active;
+        //   ,  
+        //       
+        std::vector<unsigned char> enabled;
+        std::vector<int> tree;
+        int count;
+        // ,   ,   ,
+        //      
+        std::vector<int> touched, switched;
+
+        //    (   )
+        std::vector<int> marking0;
+        std::vector<unsigned char> enabled0;
+        std::vector<int> tree0;
+        int count0;
+        bool ready;
+        //   ,     
+        // ,       
+        std::vector<int> dirtyplaces, dirtytrans;
+        std::vector<unsigned char> pldirty, trdirty;
+
+        state_type(): count(0), count0(0), ready(false) {}
+    };
+
+    //       (splitmix64)
+    static
+    unsigned long long random(
+        unsigned long long seed, unsigned long long rep, unsigned long long step)
+    {
+        unsigned long long x = seed + rep * 0x9E3779B97F4A7C15ULL +
+            step * 0xD1B54A32D192ED03ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+
+    // -------     -------
+
+    //       
+    bool has_tokens(const state_type &s, int t) const
+    {
+        const arcmatrix_type &in = m_net.m_mtxin;
+        for (int k = in.start[t]; k < in.start[t + 1]; ++k)
+            if (s.marking[in.index[k]] < in.weight[k])
+                return false;
+        return true;
+    }
+    //    (    )
+    bool is_enabled(const state_type &s, int t) const
+    {
+        int owner = m_net.m_netowner[m_net.m_trnet[t]];
+        return (owner < 0 || s.active[owner]) && !s.active[t] &&
+            has_tokens(s, t);
+    }
+    //      ,  
+    // (    )
+    bool net_active(const state_type &s, int net) const
+    {
+        const arcmatrix_type &tr = m_net.m_nettrans;
+        for (int k = tr.start[net]; k < tr.start[net + 1]; ++k)
+        {
+            int t = tr.index[k];
+            if (s.active[t] || has_tokens(s, t))
+                return true;
+        };
+        return false;
+    }
+
+    // -------   -------
+
+    //        
+    void rebuild(state_type &s) const
+    {
+        int trnum = m_net.m_trptr.size();
+        s.count = 0;
+        s.tree.assign(trnum + 1, 0);
+        for (int t = 0; t < trnum; ++t)
+        {
+            s.enabled[t] = is_enabled(s, t);
+            s.count += s.enabled[t];
+            s.tree[t + 1] += s.enabled[t];
+            int parent = (t + 1) + ((t + 1) & -(t + 1));
+            if (parent <= trnum)
+                s.tree[parent] += s.tree[t + 1];
+        };
+    }
+    //    
+    void set_enabled(state_type &s, int t, bool enabled) const
+    {
+        int delta = enabled ? 1 : -1;
+        s.enabled[t] = enabled;
+        s.count += delta;
+        for (int k = t + 1; k < int(s.tree.size()); k += k & -k)
+            s.tree[k] += delta;
+    }
+    //   
+    void update(state_type &s, int t) const
+    {
+        bool enabled = is_enabled(s, t);
+        if (bool(s.enabled[t]) == enabled)
+            return;
+        mark_transition(s, t);
+        set_enabled(s, t, enabled);
+    }
+    //  k- ( )     
+    // (  k-    flatnet_type)
+    int locate(const state_type &s, int k) const
+    {
+        int trnum = s.tree.size() - 1;
+        int step = 1;
+        while (step * 2 <= trnum)
+            step *= 2;
+        int t = 0;
+        for (; step > 0; step /= 2)
+        {
+            if (t + step <= trnum && s.tree[t + step] <= k)
+            {
+                t += step;
+                k -= s.tree[t];
+            };
+        };
+        return t;
+    }
+
+    // -------  -------
+
+    //    ,   
+    //   
+    void mark_place(state_type &s, int j) const
+    {
+        if (s.pldirty[j])
+            return;
+        s.pldirty[j] = true;
+        s.dirtyplaces.push_back(j);
+    }
+    void mark_transition(state_type &s, int t) const
+    {
+        if (s.trdirty[t])
+            return;
+        s.trdirty[t] = true;
+        s.dirtytrans.push_back(t);
+    }
+
+    void change_marking(state_type &s, int j, int value) const
+    {
+        if (s.marking[j] == value)
+            return;
+        mark_place(s, j);
+        s.marking[j] = value;
+        s.touched.push_back(j);
+    }
+    void change_active(state_type &s, int t, bool value) const
+    {
+        if (bool(s.active[t]) == value)
+            return;
+        mark_transition(s, t);
+        s.active[t] = value;
+        s.switched.push_back(t);
+    }
+
+    //   :   
+    //    ,    
+    //   ,    
+    //     ,   
+    void activate(state_type &s) const
+    {
+        int plnum = m_net.m_plptr.size(), trnum = m_net.m_trptr.size();
+        if (!s.ready)
+        {
+            s.marking.assign(plnum, 0);
+            for (int j = m_net.m_netplace[0]; j < m_net.m_netplace[1]; ++j)
+                s.marking[j] = m_net.m_marking_init[j];
+            s.active.assign(trnum, 0);
+            s.enabled.assign(trnum, 0);
+            rebuild(s);
+            s.marking0 = s.marking;
+            s.enabled0 = s.enabled;
+            s.tree0 = s.tree;
+            s.count0 = s.count;
+            s.pldirty.assign(plnum, false);
+            s.trdirty.assign(trnum, false);
+            s.ready = true;
+            return;
+        };
+
+        std::vector<int>::const_iterator it;
+        for (it = s.dirtyplaces.begin(); it != s.dirtyplaces.end(); ++it)
+        {
+            s.marking[*it] = s.marking0[*it];
+            s.pldirty[*it] = false;
+        };
+        //     ,  
+        //  ,     
+        bool whole = s.dirtytrans.size() * 8 > size_t(trnum);
+        if (whole)
+        {
+            s.enabled = s.enabled0;
+            s.tree = s.tree0;
+            s.count = s.count0;
+        };
+        for (it = s.dirtytrans.begin(); it != s.dirtytrans.end(); ++it)
+        {
+            s.active[*it] = false;
+            if (!whole && s.enabled[*it] != s.enabled0[*it])
+                set_enabled(s, *it, s.enabled0[*it]);
+            s.trdirty[*it] = false;
+        };
+        s.dirtyplaces.clear();
+        s.dirtytrans.clear();
+    }
+
+    //   ( flatnet_type::fire,  
+    //  )     
+    // ,    
+    void fire(state_type &s, int t) const
+    {
+        const arcmatrix_type &in = m_net.m_mtxin;
+        const arcmatrix_type &out = m_net.m_mtxout;
+        const arcmatrix_type &tr = m_net.m_nettrans;
+        s.touched.clear();
+        s.switched.clear();
+
+        for (int k = in.start[t]; k < in.start[t + 1]; ++k)
+            change_marking(s, in.index[k],
+                s.marking[in.index[k]] - in.weight[k]);
+        int child = m_net.m_trchild[t];
+        if (child >= 0)
+        {
+            for (int j = m_net.m_netplace[child];
+                j < m_net.m_netplace[child + 1]; ++j)
+                change_marking(s, j, m_net.m_marking_init[j]);
+            for (int k = tr.start[child]; k < tr.start[child + 1]; ++k)
+                change_active(s, tr.index[k], false);
+            change_active(s, t, net_active(s, child));
+        };
+        for (int cur = t; !s.active[cur]; )
+        {
+            for (int k = out.start[cur]; k < out.start[cur + 1]; ++k)
+                change_marking(s, out.index[k],
+                    s.marking[out.index[k]] + out.weight[k]);
+            int net = m_net.m_trnet[cur];
+            cur = m_net.m_netowner[net];
+            if (cur < 0 || net_active(s, net))
+                break;
+            change_active(s, cur, false);
+        };
+
+        //      ,
+        //     
+        update(s, t);
+        const arcmatrix_type &consumers = m_net.m_consumers;
+        for (size_t i = 0; i < s.touched.size(); ++i)
+        {
+            int j = s.touched[i];
+            for (int k = consumers.start[j]; k < consumers.start[j + 1]; ++k)
+                update(s, consumers.index[k]);
+        };
+        for (size_t i = 0; i < s.switched.size(); ++i)
+        {
+            int x = s.switched[i];
+            update(s, x);
+            child = m_net.m_trchild[x];
+            for (int k = tr.start[child]; k < tr.start[child + 1]; ++k)
+                update(s, tr.index[k]);
+        };
+    }
+
+    //      [first, first + count)
+    //     
+    void run_block(
+        long long first,
+        int count,
+        unsigned long long seed,
+        long long maxsteps,
+        state_type &s,
+        result_type &res) const
+    {
+        for (long long rep = first; rep < first + count; ++rep)
+        {
+            activate(s);
+            long long step = 0;
+            for (; s.count > 0 && step < maxsteps; ++step)
+            {
+                int t = locate(s,
+                    int(random(seed, rep, step) % s.count));
+                ++res.fired[t];
+                fire(s, t);
+            };
+            //  ,     
+            if (s.count == 0)
+                ++res.terminated;
+            res.sum_steps += step;
+            res.max_steps = std::max(res.max_steps, step);
+            if (res.min_steps < 0 || step < res.min_steps)
+                res.min_steps = step;
+        };
+    }
+
+public:
+    //       
+    explicit
+    batch_type(const transition_compound_type &root):
+        m_net(root)
+    {}
+
+    //       
+    //        
+    //    (  -   )
+    report_type run(
+        long long replications,
+        unsigned long long seed,
+        long long maxsteps,
+        int threads = 0) const
+    {
+        if (threads <= 0)
+            threads = std::thread::hardware_concurrency();
+        if (threads <= 0)
+            threads = 1;
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+
+        //       ,
+        //       
+        std::vector<result_type> results(threads);
+        std::atomic<long long> next(0);
+        std::vector<std::thread> pool;
+        for (int i = 0; i < threads; ++i)
+            pool.push_back(std::thread(&batch_type::run_blocks, this,
+                replications, seed, maxsteps,
+                std::ref(next), std::ref(results[i])));
+        for (int i = 0; i < threads; ++i)
+            pool[i].join();
+
+        //   
+        report_type report;
+        report.replications = replications;
+        report.terminated = 0;
+        report.min_steps = -1;
+        report.max_steps = 0;
+        long long sum = 0;
+        std::vector<long long> fired(m_net.m_trptr.size(), 0);
+        for (int i = 0; i < threads; ++i)
+        {
+            const result_type &r = results[i];
+            report.terminated += r.terminated;
+            sum += r.sum_steps;
+            report.max_steps = std::max(report.max_steps, r.max_steps);
+            if (r.min_steps >= 0 &&
+                (report.min_steps < 0 || r.min_steps < report.min_steps))
+                report.min_steps = r.min_steps;
+            for (size_t t = 0; t < fired.size(); ++t)
+                fired[t] += r.fired[t];
+        };
+        report.mean_steps = replications > 0 ? double(sum) / replications : 0;
+        for (size_t t = 0; t < fired.size(); ++t)
+            report.fired[m_net.m_trptr[t]] += fired[t];
+        report.seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        return report;
+    }
+
+private:
+    //   
+    void run_blocks(
+        long long replications,
+        unsigned long long seed,
+        long long maxsteps,
+        std::atomic<long long> &next,
+        result_type &res) const
+    {
+        res.terminated = 0;
+        res.min_steps = -1;
+        res.max_steps = 0;
+        res.sum_steps = 0;
+        res.fired.assign(m_net.m_trptr.size(), 0);
+        state_type s;
+        long long blocks = (replications + blocksize - 1) / blocksize;
+        for (;;)
+        {
+            long long b = next++;
+            if (b >= blocks)
+                break;
+            long long first = b * blocksize;
+            int count = std::min<long long>(blocksize, replications - first);
+            run_block(first, count, seed, maxsteps, s, res);
+        };
+    }
+};
+
+} // namespace petri
+} // namespace z
+
+#endif /* _ZPETRI_BATCH_HXX_ */
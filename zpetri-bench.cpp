@@ -0,0 +1,354 @@
+/* ------------------------------------------------------------------------- */
+/*        ,                  */
+/*     :                              */
+/*   ..                                                             */
+/*    . - .: -, 2012. - 384 . */
+/*  ISBN 978-5-91359-102-9                                                   */
+/*                                                                           */
+/*     ,           */
+/*                   */
+/*   ,      .  */
+/*                   */
+/*  ,                 */
+/*       .                                     */
+/*     " ",            */
+/*         .       */
+/*                                                                           */
+/*  Copyright  2008-2011  ..                                       */
+/* ------------------------------------------------------------------------- */
+
+
+//    :  
+//   ,   ,
+//   ,      ,
+//      (  
+//        )
+//
+// : zpetri-bench [ [  JSON]]
+// (        
+// ;     -1)
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <fstream>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include "zpetri.hxx"
+#include "zpetri-flat.hxx"
+#include "zpetri-monitor.hxx"
+#include "zpetri-snapshot.hxx"
+
+using namespace std;
+using namespace z;
+using namespace z::petri;
+
+// -------    -------
+
+//       
+static std::atomic<long long> g_allocs(0);
+static std::atomic<long long> g_heap(0);
+
+//        
+static const size_t header_size = alignof(std::max_align_t);
+
+void *operator new(size_t size)
+{
+    char *p = (char *)malloc(size + header_size);
+    if (!p)
+        throw std::bad_alloc();
+    *(size_t *)p = size;
+    ++g_allocs;
+    g_heap += size;
+    return p + header_size;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    if (!ptr)
+        return;
+    char *p = (char *)((uintptr_t)ptr - header_size);
+    g_heap -= *(size_t *)p;
+    free(p);
+}
+
+// -------   -------
+
+//        
+struct net_type
+{
+    std::deque<place_type> places;
+    std::deque<transition_simple_type> simple;
+    std::deque<transition_compound_type> compound;
+    petrinet_type::content_type content;
+
+    place_type &new_place(void)
+    {
+        places.resize(places.size() + 1);
+        content.add_place(places.back());
+        return places.back();
+    }
+    transition_simple_type &new_simple(void)
+    {
+        simple.resize(simple.size() + 1);
+        content.add_transition(simple.back());
+        return simple.back();
+    }
+};
+
+//   stages ,   dataflow.cpp:
+//    ,     
+void make_pipeline(net_type &net, int stages, int tokens)
+{
+    place_type *in = &net.new_place();
+    net.content.add_token(*in, tokens);
+    for (int i = 0; i < stages; ++i)
+    {
+        transition_simple_type &split = net.new_simple();
+        transition_simple_type &join = net.new_simple();
+        net.content.add_arc(*in, split);
+        for (int k = 0; k < 3; ++k)
+        {
+            place_type &before = net.new_place();
+            place_type &after = net.new_place();
+            transition_simple_type &work = net.new_simple();
+            net.content.add_arc(split, before);
+            net.content.add_arc(before, work);
+            net.content.add_arc(work, after);
+            net.content.add_arc(after, join);
+        };
+        in = &net.new_place();
+        net.content.add_arc(join, *in);
+    };
+}
+
+// width ,     
+void make_conflict(net_type &net, int width, int tokens)
+{
+    place_type &source = net.new_place();
+    place_type &sink = net.new_place();
+    net.content.add_token(source, tokens);
+    for (int i = 0; i < width; ++i)
+    {
+        transition_simple_type &tr = net.new_simple();
+        net.content.add_arc(source, tr);
+        net.content.add_arc(tr, sink);
+    };
+}
+
+//   depth   ,   
+// width    (   -  )
+void make_nested(net_type &net, int depth, int width)
+{
+    transition_abstract_type *inner = 0;
+    for (int level = 0; level <= depth; ++level)
+    {
+        transition_compound_type::content_type content;
+        net.places.resize(net.places.size() + 2);
+        place_type &source = net.places[net.places.size() - 2];
+        place_type &sink = net.places.back();
+        if (!inner)
+        {
+            net.simple.resize(1);
+            inner = &net.simple.back();
+        };
+        content.add_place(source);
+        content.add_place(sink);
+        content.add_transition(*inner);
+        content.add_arc(source, *inner);
+        content.add_arc(*inner, sink);
+        content.add_token(source, width);
+        if (level == depth)
+            net.content = content;
+        else
+        {
+            net.compound.push_back(transition_compound_type(content));
+            inner = &net.compound.back();
+        };
+    };
+}
+
+// -------  -------
+
+typedef std::chrono::steady_clock clock_type;
+
+double seconds_since(clock_type::time_point start)
+{
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+//   ,     
+class benchenv_type: public petrinet_type::environment_view_abstract_type
+{
+private:
+    unsigned long long m_state;
+
+public:
+    benchenv_type(): m_state(1) {}
+
+    int pick(int bound)
+    {
+        m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return int((m_state >> 33) % bound);
+    }
+    int wait(
+        const enabledview_type &enabled,
+        const markedview_type &)
+    {
+        return pick(enabled.size());
+    }
+};
+
+//       fire
+//   
+template <class net_type>
+long long run(net_type &net)
+{
+    benchenv_type env;
+    long long steps = 0;
+    net.activate();
+    while (net.is_active())
+    {
+        net.fire(env.pick(net.get_enabled().size()));
+        ++steps;
+    };
+    return steps;
+}
+
+//   ,    
+void bench(const char *name, net_type &net, monitor_type *stat)
+{
+    long long heap0 = g_heap;
+    clock_type::time_point start = clock_type::now();
+    petrinet_type petrinet(net.content);
+    double build = seconds_since(start);
+    long long heap = g_heap - heap0;
+
+    //       
+    // (     )
+    double load = -1;
+    const char *filename = "zpetri-bench.zpn";
+    if (snapshot_type::save(filename, petrinet))
+    {
+        start = clock_type::now();
+        snapshot_type snapshot;
+        if (snapshot.open(filename))
+        {
+            petrinet_type loaded(snapshot.image());
+            load = seconds_since(start);
+        };
+        std::remove(filename);
+    };
+
+    //      
+    //       (refresh)
+    start = clock_type::now();
+    petrinet.activate();
+    double activate = seconds_since(start);
+
+    //         
+    long long allocs = g_allocs;
+    start = clock_type::now();
+    long long steps = run(petrinet);
+    double fire = seconds_since(start);
+    allocs = g_allocs - allocs;
+
+    //     
+    heap0 = g_heap;
+    flatnet_type flatnet(petrinet);
+    long long flatheap = g_heap - heap0;
+    start = clock_type::now();
+    long long flatsteps = run(flatnet);
+    double flatfire = seconds_since(start);
+
+    //        :
+    //     ,   
+    //       (  
+    //      )
+    const int repeats = 7;
+    const double duration = 0.5;
+    double live = 0, monitored = 0, total = 0;
+    monitor_type monitor;
+    for (int k = 0; k <= repeats || (total < duration && k <= 1000); ++k)
+    {
+        benchenv_type env;
+        start = clock_type::now();
+        petrinet.live(env);
+        double plain = seconds_since(start);
+        petrinet.set_monitor(&monitor);
+        benchenv_type monenv;
+        start = clock_type::now();
+        petrinet.live(monenv);
+        double watched = seconds_since(start);
+        petrinet.set_monitor(0);
+        if (k > 0)
+            total += plain;
+        if (k == 1 || (k > 1 && plain < live))
+            live = plain;
+        if (k == 1 || (k > 1 && watched < monitored))
+            monitored = watched;
+    };
+    //    -   
+    if (stat)
+    {
+        benchenv_type env;
+        petrinet.set_monitor(stat);
+        petrinet.live(env);
+        petrinet.set_monitor(0);
+    };
+
+    printf("%-10s %8d %8d %9.2f %9.2f %9.3f %9lld %11.0f %11.0f %7.3f "
+        "%9lld %9lld %+8.1f%%\n",
+        name, int(net.places.size()),
+        int(net.simple.size() + net.compound.size()),
+        build * 1e3, load < 0 ? -1 : load * 1e3, activate * 1e3, steps, steps / fire,
+        flatsteps / flatfire, double(allocs) / (steps ? steps : 1),
+        heap / 1024, flatheap / 1024, (monitored / live - 1) * 100);
+}
+
+int main(int argc, char *argv[])
+{
+    //   
+    int scale = argc > 1 ? atoi(argv[1]) : 1;
+    if (scale <= 0)
+        scale = 1;
+    //     
+    monitor_type stat;
+
+    printf("%-10s %8s %8s %9s %9s %9s %9s %11s %11s %7s %9s %9s %9s\n",
+        "net", "places", "trans", "build,ms", "load,ms", "activ,ms", "fires",
+        "fires/s", "flat f/s", "alloc/f", "heap,KB", "flat,KB",
+        "monitor");
+    {
+        net_type net;
+        make_pipeline(net, 1000 * scale, 20);
+        bench("pipeline", net, &stat);
+    }
+    {
+        net_type net;
+        make_conflict(net, 1000 * scale, 10000);
+        bench("conflict", net, 0);
+    }
+    {
+        net_type net;
+        make_nested(net, 16, 2);
+        bench("nested", net, 0);
+    }
+    {
+        net_type net;
+        make_pipeline(net, 4, 100000 * scale);
+        bench("tokens", net, 0);
+    }
+
+    if (argc > 2)
+    {
+        std::ofstream os(argv[2]);
+        stat.write_json(os);
+    };
+
+    return 0;
+}
@@ -0,0 +1,260 @@
+/* ------------------------------------------------------------------------- */
+/*        ,                  */
+/*     :                              */
+/*   ..                                                             */
+/*    . - .: -, 2012. - 384 . */
+/*  ISBN 978-5-91359-102-9                                                   */
+/*                                                                           */
+/*     ,           */
+/*                   */
+/*   ,      .  */
+/*                   */
+/*  ,                 */
+/*       .                                     */
+/*     " ",            */
+/*         .       */
+/*                                                                           */
+/*  Copyright  2008-2011  ..                                       */
+/* ------------------------------------------------------------------------- */
+
+
+#ifndef _ZPETRI_CHANNEL_HXX_
+#define _ZPETRI_CHANNEL_HXX_
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <cstddef>
+#include "zpetri.hxx"
+
+namespace z {
+namespace petri {
+
+//         
+// ;  ,     ,
+//    ( T -   
+//  )
+template <class T>
+class spsc_queue_type
+{
+private:
+    std::vector<T> m_buffer;
+    size_t m_mask;
+    //    
+    std::atomic<size_t> m_head;
+    //        
+    char m_pad[64];
+    //    
+    std::atomic<size_t> m_tail;
+
+    spsc_queue_type(const spsc_queue_type &);
+    spsc_queue_type &operator =(const spsc_queue_type &);
+
+public:
+    explicit
+    spsc_queue_type(size_t capacity): m_head(0), m_tail(0)
+    {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+        m_buffer.resize(size);
+        m_mask = size - 1;
+    }
+
+    //   (false,   )
+    bool try_push(T &&value)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) > m_mask)
+            return false;
+        m_buffer[tail & m_mask] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    //   (false,   )
+    bool try_pop(T &value)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+        value = std::move(m_buffer[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    //   (,    )
+    size_t size(void) const
+    {
+        return m_tail.load(std::memory_order_acquire) -
+            m_head.load(std::memory_order_acquire);
+    }
+    size_t capacity(void) const
+    {
+        return m_mask + 1;
+    }
+};
+
+//         ;
+//       ,  
+//  ,      
+//     
+template <class T>
+class mpmc_queue_type
+{
+private:
+    struct cell_type
+    {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::vector<cell_type> m_cells;
+    size_t m_mask;
+    //    
+    std::atomic<size_t> m_head;
+    //        
+    char m_pad[64];
+    //    
+    std::atomic<size_t> m_tail;
+
+    mpmc_queue_type(const mpmc_queue_type &);
+    mpmc_queue_type &operator =(const mpmc_queue_type &);
+
+public:
+    explicit
+    mpmc_queue_type(size_t capacity): m_head(0), m_tail(0)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        std::vector<cell_type> cells(size);
+        m_cells.swap(cells);
+        for (size_t i = 0; i < size; ++i)
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+        m_mask = size - 1;
+    }
+
+    //   (false,   )
+    bool try_push(T &&value)
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        cell_type *cell;
+        for (;;)
+        {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            ptrdiff_t diff = ptrdiff_t(seq) - ptrdiff_t(pos);
+            //   -   
+            if (diff == 0)
+            {
+                if (m_tail.compare_exchange_weak(
+                    pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            //      -  
+            else if (diff < 0)
+                return false;
+            //    
+            else
+                pos = m_tail.load(std::memory_order_relaxed);
+        };
+        cell->value = std::move(value);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+    //   (false,   
+    //      )
+    bool try_pop(T &value)
+    {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        cell_type *cell;
+        for (;;)
+        {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            ptrdiff_t diff = ptrdiff_t(seq) - ptrdiff_t(pos + 1);
+            if (diff == 0)
+            {
+                if (m_head.compare_exchange_weak(
+                    pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = m_head.load(std::memory_order_relaxed);
+        };
+        value = std::move(cell->value);
+        cell->seq.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+    //   (,    )
+    size_t size(void) const
+    {
+        size_t head = m_head.load(std::memory_order_acquire);
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+    size_t capacity(void) const
+    {
+        return m_mask + 1;
+    }
+};
+
+// ,      T
+//     queue_type:   -  
+//   , spsc_queue_type ,   
+//    ,   - 
+//
+//       
+// (take)     (put)    ;
+//        :
+//      ,   
+//  ,     ,  
+//    ;    
+//  ,  ,   ,   
+//   ( ,      )
+template <class T, class queue_type = mpmc_queue_type<T> >
+class channel_type: public place_type
+{
+private:
+    queue_type m_queue;
+
+public:
+    //        
+    //  ,  put    
+    explicit
+    channel_type(size_t capacity): m_queue(capacity) {}
+
+    //   (   -   ,
+    //       )
+    void put(T &&value)
+    {
+        while (!m_queue.try_push(std::move(value)))
+            std::this_thread::yield();
+    }
+    //   ,    
+    // (      
+    //    )
+    T take(void)
+    {
+        T value;
+        while (!m_queue.try_pop(value))
+            std::this_thread::yield();
+        return value;
+    }
+    //    
+    size_t size(void) const
+    {
+        return m_queue.size();
+    }
+    size_t capacity(void) const
+    {
+        return m_queue.capacity();
+    }
+};
+
+} // namespace petri
+} // namespace z
+
+#endif /* _ZPETRI_CHANNEL_HXX_ */
@@ -0,0 +1,1349 @@
+/* ------------------------------------------------------------------------- */
+/*        ,                  */
+/*     :                              */
+/*   ..                                                             */
+/*    . - .: -, 2012. - 384 . */
+/*  ISBN 978-5-91359-102-9                                                   */
+/*                                                                           */
+/*     ,           */
+/*                   */
+/*   ,      .  */
+/*                   */
+/*  ,                 */
+/*       .                                     */
+/*     " ",            */
+/*         .       */
+/*                                                                           */
+/*  Copyright  2008-2011  ..                                       */
+/* ------------------------------------------------------------------------- */
+
+
+//    :    ,
+//        ,
+//        , 
+//       
+// (       
+//     fire - ZPETRI_CHECK_INCREMENTAL);
+//   ,   (zpetri-flat.hxx)
+//      (zpetri-reach.hxx),
+//   (zpetri-batch.hxx),   
+//  (zpetri-snapshot.hxx),     ,
+//   PNML (zpetri-pnml.hxx);   
+//    
+//
+// : zpetri-check [ ]
+//     ,      
+
+#undef NDEBUG
+#define ZPETRI_CHECK_INCREMENTAL
+
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <cstring>
+#include <string>
+#include <sstream>
+#include <deque>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include "zpetri.hxx"
+#include "zpetri-flat.hxx"
+#include "zpetri-reach.hxx"
+#include "zpetri-batch.hxx"
+#include "zpetri-snapshot.hxx"
+#include "zpetri-pnml.hxx"
+
+using namespace std;
+using namespace z;
+using namespace z::petri;
+
+// -------   -------
+
+//    (   )
+int pick(unsigned &seed, int bound)
+{
+    seed = seed * 1103515245u + 12345u;
+    return int((seed >> 16) & 0x7fff) % bound;
+}
+
+//    
+struct netdesc_type
+{
+    //         
+    int plbase, trbase;
+    //    
+    int places, transitions;
+    //    (-1  )
+    std::vector<int> child;
+    //      [][]
+    std::vector<std::vector<int> > in, out;
+    //  
+    std::vector<int> init;
+};
+
+//   ( -   )
+struct hierarchy_type
+{
+    std::vector<netdesc_type> nets;
+    //     
+    int places, transitions;
+
+    hierarchy_type(): places(0), transitions(0) {}
+};
+
+//     np   nt ,
+//      depth 
+// (       ,
+//  ,    )
+//   
+int generate(
+    hierarchy_type &h, unsigned &seed, int depth, int np, int nt,
+    bool bounded)
+{
+    int net = h.nets.size();
+    h.nets.resize(net + 1);
+    h.nets[net].plbase = h.places;
+    h.nets[net].trbase = h.transitions;
+    h.nets[net].places = np;
+    h.nets[net].transitions = nt;
+    h.places += np;
+    h.transitions += nt;
+
+    //    ,   
+    //    (  )
+    std::vector<int> child(nt, -1);
+    for (int i = 0; i < nt; ++i)
+    {
+        if (depth > 0 && pick(seed, 4) == 0)
+        {
+            int cnp = 2 + pick(seed, 4);
+            int cnt = 1 + pick(seed, 4);
+            child[i] = generate(h, seed, depth - 1, cnp, cnt, bounded);
+        };
+    };
+    netdesc_type &desc = h.nets[net];
+    desc.child = child;
+    desc.in.assign(nt, std::vector<int>(np, 0));
+    desc.out.assign(nt, std::vector<int>(np, 0));
+    for (int i = 0; i < nt; ++i)
+    {
+        int consumed = 0, produced = 0;
+        for (int k = pick(seed, 3); k > 0; --k)
+        {
+            int weight = 1 + pick(seed, 2);
+            desc.in[i][pick(seed, np)] += weight;
+            consumed += weight;
+        };
+        for (int k = pick(seed, 3); k > 0; --k)
+        {
+            int weight = 1 + pick(seed, 2);
+            int j = pick(seed, np);
+            if (bounded && produced + weight > consumed)
+                continue;
+            desc.out[i][j] += weight;
+            produced += weight;
+        };
+    };
+    desc.init.assign(np, 0);
+    for (int j = 0; j < np; ++j)
+        if (pick(seed, 2))
+            desc.init[j] = 1 + pick(seed, 3);
+    return net;
+}
+
+// -------  ,    -------
+
+//   :    
+//    (~)  
+std::vector<int> *g_log = 0;
+
+class logged_simple_type: public transition_simple_type
+{
+private:
+    int m_id;
+
+public:
+    explicit
+    logged_simple_type(int id): m_id(id) {}
+
+    void on_activate(void)
+    {
+        g_log->push_back(m_id);
+    }
+    void on_passivate(void)
+    {
+        g_log->push_back(~m_id);
+    }
+};
+
+class logged_compound_type: public transition_compound_type
+{
+private:
+    int m_id;
+
+public:
+    logged_compound_type(const content_type &content, int id):
+        transition_compound_type(content), m_id(id)
+    {}
+
+    void on_activate(void)
+    {
+        g_log->push_back(m_id);
+    }
+    void on_passivate(void)
+    {
+        g_log->push_back(~m_id);
+    }
+};
+
+//      
+struct objects_type
+{
+    std::deque<place_type> places;
+    std::deque<logged_simple_type> simple;
+    std::deque<logged_compound_type> compound;
+    std::map<const place_type *, int> plindex;
+    std::map<const transition_abstract_type *, int> trindex;
+};
+
+//    net (   )
+transition_compound_type::content_type assemble(
+    const hierarchy_type &h, objects_type &obj, int net)
+{
+    const netdesc_type &desc = h.nets[net];
+    if (obj.places.empty())
+    {
+        obj.places.resize(h.places);
+        for (int j = 0; j < h.places; ++j)
+            obj.plindex[&obj.places[j]] = j;
+    };
+
+    transition_compound_type::content_type content;
+    for (int j = 0; j < desc.places; ++j)
+        content.add_place(obj.places[desc.plbase + j]);
+    std::vector<transition_abstract_type *> local(desc.transitions);
+    for (int i = 0; i < desc.transitions; ++i)
+    {
+        int id = desc.trbase + i;
+        if (desc.child[i] < 0)
+        {
+            obj.simple.push_back(logged_simple_type(id));
+            local[i] = &obj.simple.back();
+        }
+        else
+        {
+            obj.compound.push_back(logged_compound_type(
+                assemble(h, obj, desc.child[i]), id));
+            local[i] = &obj.compound.back();
+        };
+        obj.trindex[local[i]] = id;
+        content.add_transition(*local[i]);
+    };
+    for (int i = 0; i < desc.transitions; ++i)
+    {
+        for (int j = 0; j < desc.places; ++j)
+        {
+            place_type &pl = obj.places[desc.plbase + j];
+            if (desc.in[i][j] > 0)
+                content.add_arc(pl, *local[i], desc.in[i][j]);
+            if (desc.out[i][j] > 0)
+                content.add_arc(*local[i], pl, desc.out[i][j]);
+        };
+    };
+    for (int j = 0; j < desc.places; ++j)
+        if (desc.init[j] > 0)
+            content.add_token(obj.places[desc.plbase + j], desc.init[j]);
+    return content;
+}
+
+// -------   -------
+
+//     - 
+// :      
+class model_type
+{
+private:
+    const hierarchy_type &m_h;
+    //     
+    // (     )
+    std::vector<int> m_marking;
+    //      
+    std::vector<char> m_active;
+
+    //  i-     
+    void area(int net, int i, std::vector<int> &list) const
+    {
+        const netdesc_type &desc = m_h.nets[net];
+        int id = desc.trbase + i;
+        if (desc.child[i] >= 0 && m_active[id])
+        {
+            enabled(desc.child[i], list);
+            return;
+        };
+        for (int j = 0; j < desc.places; ++j)
+            if (m_marking[desc.plbase + j] < desc.in[i][j])
+                return;
+        list.push_back(id);
+    }
+
+    //  i-  
+    void fire_local(int net, int i, int lower)
+    {
+        const netdesc_type &desc = m_h.nets[net];
+        int id = desc.trbase + i;
+        int child = desc.child[i];
+        if (child >= 0 && m_active[id])
+            fire(child, lower);
+        else
+        {
+            for (int j = 0; j < desc.places; ++j)
+                m_marking[desc.plbase + j] -= desc.in[i][j];
+            g_log->push_back(id);
+            if (child >= 0)
+                activate(child);
+        };
+        m_active[id] = child >= 0 && is_active(child);
+        if (!m_active[id])
+        {
+            g_log->push_back(~id);
+            for (int j = 0; j < desc.places; ++j)
+                m_marking[desc.plbase + j] += desc.out[i][j];
+        };
+    }
+
+public:
+    explicit
+    model_type(const hierarchy_type &h):
+        m_h(h), m_marking(h.places, 0), m_active(h.transitions, 0)
+    {}
+
+    //  :  ,  
+    void activate(int net = 0)
+    {
+        const netdesc_type &desc = m_h.nets[net];
+        for (int j = 0; j < desc.places; ++j)
+            m_marking[desc.plbase + j] = desc.init[j];
+        for (int i = 0; i < desc.transitions; ++i)
+            m_active[desc.trbase + i] = 0;
+    }
+    bool is_active(int net = 0) const
+    {
+        std::vector<int> list;
+        enabled(net, list);
+        return !list.empty();
+    }
+    //     (   )
+    void enabled(int net, std::vector<int> &list) const
+    {
+        for (int i = 0; i < m_h.nets[net].transitions; ++i)
+            area(net, i, list);
+    }
+    //        
+    void marked(int net, std::map<int, int> &marked) const
+    {
+        const netdesc_type &desc = m_h.nets[net];
+        for (int j = 0; j < desc.places; ++j)
+            if (m_marking[desc.plbase + j] > 0)
+                marked[desc.plbase + j] = m_marking[desc.plbase + j];
+        for (int i = 0; i < desc.transitions; ++i)
+            if (desc.child[i] >= 0 && m_active[desc.trbase + i])
+                this->marked(desc.child[i], marked);
+    }
+    //     ,      :
+    //    (   )
+    //    
+    void state(std::vector<int> &key, int net = 0) const
+    {
+        const netdesc_type &desc = m_h.nets[net];
+        if (net == 0)
+        {
+            key.assign(m_h.places + m_h.transitions, 0);
+            for (int i = 0; i < m_h.transitions; ++i)
+                key[m_h.places + i] = m_active[i];
+        };
+        for (int j = 0; j < desc.places; ++j)
+            key[desc.plbase + j] = m_marking[desc.plbase + j];
+        for (int i = 0; i < desc.transitions; ++i)
+            if (desc.child[i] >= 0 && m_active[desc.trbase + i])
+                state(key, desc.child[i]);
+    }
+    //     number   
+    void fire(int net, int number)
+    {
+        for (int i = 0; i < m_h.nets[net].transitions; ++i)
+        {
+            std::vector<int> list;
+            area(net, i, list);
+            if (number < int(list.size()))
+            {
+                fire_local(net, i, number);
+                return;
+            };
+            number -= list.size();
+        };
+        assert(false);
+    }
+};
+
+// -------  -------
+
+//         
+template <class net_type>
+bool same_state(
+    const net_type &net, const model_type &model, const objects_type &obj)
+{
+    std::vector<int> expected, actual;
+    model.enabled(0, expected);
+    const transition_abstract_type::enabledlist_type &enabled =
+        net.get_enabled();
+    for (size_t i = 0; i < enabled.size(); ++i)
+    {
+        actual.push_back(obj.trindex.find(enabled[i])->second);
+        //        
+        if (net.locate(enabled[i]) != int(i))
+            return false;
+    };
+    if (actual != expected)
+        return false;
+
+    std::map<int, int> marked, tokens;
+    model.marked(0, marked);
+    transition_abstract_type::markedlist_type list = net.get_marked();
+    transition_abstract_type::markedlist_type::const_iterator it;
+    for (it = list.begin(); it != list.end(); ++it)
+        tokens[obj.plindex.find(it->first)->second] = it->second;
+    if (tokens != marked)
+        return false;
+    //       
+    for (int j = 0; j < int(obj.places.size()); ++j)
+    {
+        std::map<int, int>::const_iterator ft = marked.find(j);
+        int expected = (ft != marked.end()) ? ft->second : 0;
+        if (net.get_tokens(const_cast<place_type *>(&obj.places[j])) !=
+            expected)
+            return false;
+    };
+    return true;
+}
+
+//        
+//     -1  
+template <class net_type>
+int check_run(
+    net_type &net, const hierarchy_type &h, const objects_type &obj,
+    unsigned seed, int steps)
+{
+    std::vector<int> netlog, modellog;
+    model_type model(h);
+    net.activate();
+    model.activate();
+    int step = 0;
+    for (; step < steps; ++step)
+    {
+        if (!same_state(net, model, obj) || netlog != modellog)
+            return -1;
+        if (!net.is_active())
+            break;
+        int number = pick(seed, net.get_enabled().size());
+        g_log = &netlog;
+        net.fire(number);
+        g_log = &modellog;
+        model.fire(0, number);
+    };
+    return step;
+}
+
+//     
+void make_hierarchy(hierarchy_type &h, unsigned seed, bool bounded = false)
+{
+    int np = 6 + pick(seed, 6);
+    int nt = 4 + pick(seed, 8);
+    generate(h, seed, 3, np, nt, bounded);
+}
+
+//       
+bool check_incremental(int count)
+{
+    int failures = 0;
+    long long total = 0;
+    for (int variant = 1; variant <= count; ++variant)
+    {
+        hierarchy_type h;
+        make_hierarchy(h, variant);
+        objects_type obj;
+        petrinet_type net(assemble(h, obj, 0));
+        int steps = check_run(net, h, obj, variant, 300);
+        if (steps < 0)
+        {
+            if (++failures <= 5)
+                printf("incremental: mismatch in net %d\n", variant);
+        }
+        else
+            total += steps;
+    };
+    printf("incremental: %d nets, %lld steps, %d failures\n",
+        count, total, failures);
+    return failures == 0;
+}
+
+//     
+// (       )
+bool check_flat(int count)
+{
+    int failures = 0;
+    long long total = 0;
+    for (int variant = 1; variant <= count; ++variant)
+    {
+        hierarchy_type h;
+        make_hierarchy(h, variant);
+        objects_type obj;
+        petrinet_type net(assemble(h, obj, 0));
+        flatnet_type flatnet(net);
+        int steps = check_run(flatnet, h, obj, variant, 300);
+        if (steps < 0)
+        {
+            if (++failures <= 5)
+                printf("flat: mismatch in net %d\n", variant);
+        }
+        else
+            total += steps;
+    };
+    printf("flat: %d nets, %lld steps, %d failures\n",
+        count, total, failures);
+    return failures == 0;
+}
+
+//      
+//     -1,    maxstates
+long long explore_model(
+    const hierarchy_type &h, int maxstates, long long &edges,
+    long long &deadlocks, std::vector<int> &bounds)
+{
+    std::vector<int> dummy;
+    g_log = &dummy;
+    std::set<std::vector<int> > seen;
+    std::deque<model_type> queue;
+    std::vector<int> key;
+    edges = 0;
+    deadlocks = 0;
+    bounds.assign(h.places, 0);
+    model_type start(h);
+    start.activate();
+    start.state(key);
+    seen.insert(key);
+    queue.push_back(start);
+    while (!queue.empty() && int(seen.size()) <= maxstates)
+    {
+        model_type model = queue.front();
+        queue.pop_front();
+        model.state(key);
+        for (int j = 0; j < h.places; ++j)
+            bounds[j] = std::max(bounds[j], key[j]);
+        std::vector<int> list;
+        model.enabled(0, list);
+        if (list.empty())
+            ++deadlocks;
+        edges += list.size();
+        for (size_t k = 0; k < list.size(); ++k)
+        {
+            model_type next = model;
+            next.fire(0, k);
+            dummy.clear();
+            next.state(key);
+            if (seen.insert(key).second)
+                queue.push_back(next);
+        };
+    };
+    return int(seen.size()) > maxstates ? -1 : (long long)seen.size();
+}
+
+//       
+//   (  ,    
+//      )
+bool check_reach(int count)
+{
+    const int maxstates = 1000;
+    int failures = 0, checked = 0;
+    long long total = 0;
+    for (int variant = 1; variant <= count; ++variant)
+    {
+        hierarchy_type h;
+        make_hierarchy(h, variant, true);
+        long long edges, deadlocks;
+        std::vector<int> bounds;
+        long long states = explore_model(h, maxstates, edges, deadlocks,
+            bounds);
+        if (states < 0)
+            continue;
+
+        objects_type obj;
+        petrinet_type net(assemble(h, obj, 0));
+        reachability_type reach(net);
+        for (int threads = 1; threads <= 4; threads *= 4)
+        {
+            reachability_type::report_type report = reach.explore(threads);
+            bool ok = report.complete &&
+                report.boundedness == reachability_type::bounded &&
+                report.unbounded.empty() &&
+                report.states == states &&
+                report.edges == edges && report.deadlocks == deadlocks;
+            for (int j = 0; j < h.places; ++j)
+                ok = ok && report.bounds[&obj.places[j]] == bounds[j];
+            if (!ok && ++failures <= 5)
+                printf("reach: mismatch in net %d (%d threads)\n",
+                    variant, threads);
+        };
+        ++checked;
+        total += states;
+    };
+    printf("reach: %d nets with finite graphs, %lld states, %d failures\n",
+        checked, total, failures);
+    return failures == 0;
+}
+
+//    : ,   
+// ( i    in[i]    out[i]  extra[i],
+// -1 -  )
+void make_chain(
+    hierarchy_type &h, int net, const int *in, const int *out,
+    const int *extra, int nt)
+{
+    netdesc_type &desc = h.nets[net];
+    desc.in.assign(nt, std::vector<int>(desc.places, 0));
+    desc.out.assign(nt, std::vector<int>(desc.places, 0));
+    for (int i = 0; i < nt; ++i)
+    {
+        if (in[i] >= 0)
+            desc.in[i][in[i]] = 1;
+        if (out[i] >= 0)
+            desc.out[i][out[i]] += 1;
+        if (extra[i] >= 0)
+            desc.out[i][extra[i]] += 1;
+    };
+}
+
+//    ,   
+//  : q0 -t1-> q0 + q1 (  q1 )
+void make_growing(hierarchy_type &h)
+{
+    h.nets.resize(2);
+    h.places = 3;
+    h.transitions = 2;
+    netdesc_type &top = h.nets[0];
+    top.plbase = top.trbase = 0;
+    top.places = 1;
+    top.transitions = 1;
+    top.child.assign(1, 1);
+    const int tin[] = {0}, tout[] = {0}, textra[] = {-1};
+    make_chain(h, 0, tin, tout, textra, 1);
+    top.init.assign(1, 1);
+    netdesc_type &sub = h.nets[1];
+    sub.plbase = 1;
+    sub.trbase = 1;
+    sub.places = 2;
+    sub.transitions = 1;
+    sub.child.assign(1, -1);
+    const int sin[] = {0}, sout[] = {0}, sextra[] = {1};
+    make_chain(h, 1, sin, sout, sextra, 1);
+    sub.init.assign(2, 0);
+    sub.init[0] = 1;
+}
+
+//  :     
+//         
+// (   ,     ,
+//       )
+bool check_unbounded(int count)
+{
+    int failures = 0, detected = 0, infinite = 0;
+
+    //  : p0 -t0-> p0 + p1, p1 -t1-> p2 (p1  p2 )
+    //  p3 -t2-> p4 ( );   
+    //  -       
+    {
+        hierarchy_type h;
+        h.nets.resize(1);
+        netdesc_type &desc = h.nets[0];
+        desc.plbase = desc.trbase = 0;
+        desc.places = h.places = 5;
+        desc.transitions = h.transitions = 3;
+        desc.child.assign(3, -1);
+        const int in[] = {0, 1, 3}, out[] = {0, 2, 4}, extra[] = {1, -1, -1};
+        make_chain(h, 0, in, out, extra, 3);
+        desc.init.assign(5, 0);
+        desc.init[0] = desc.init[3] = 1;
+
+        objects_type obj;
+        petrinet_type net(assemble(h, obj, 0));
+        reachability_type reach(net);
+        for (int threads = 1; threads <= 4; threads *= 4)
+        {
+            reachability_type::report_type report =
+                reach.explore(threads, 100000);
+            std::vector<place_type *> &list = report.unbounded;
+            bool ok = !report.complete &&
+                report.boundedness == reachability_type::unbounded &&
+                !list.empty();
+            for (size_t k = 0; k < list.size(); ++k)
+                ok = ok && (list[k] == &obj.places[1] ||
+                    list[k] == &obj.places[2]);
+            if (!ok && ++failures <= 5)
+                printf("unbounded: top-level source not detected "
+                    "(%d threads)\n", threads);
+        };
+    }
+
+    //      
+    //  :     unknown
+    {
+        hierarchy_type h;
+        make_growing(h);
+        objects_type obj;
+        petrinet_type net(assemble(h, obj, 0));
+        reachability_type reach(net);
+        reachability_type::report_type report = reach.explore(2, 100);
+        bool ok = !report.complete &&
+            report.boundedness == reachability_type::unknown &&
+            report.states == 100 && report.unbounded.empty();
+        if (!ok && ++failures <= 5)
+            printf("unbounded: subnet growth not reported as unknown\n");
+    }
+
+    //  
+    for (int variant = 1; variant <= count; ++variant)
+    {
+        hierarchy_type h;
+        make_hierarchy(h, variant);
+        long long edges, deadlocks;
+        std::vector<int> bounds;
+        long long states = explore_model(h, 300, edges, deadlocks, bounds);
+
+        objects_type obj;
+        petrinet_type net(assemble(h, obj, 0));
+        reachability_type reach(net);
+        reachability_type::report_type report = reach.explore(2, 2000);
+        bool ok;
+        if (states >= 0)
+            ok = report.boundedness == reachability_type::bounded &&
+                report.states == states && report.edges == edges;
+        else
+        {
+            ok = report.boundedness != reachability_type::bounded &&
+                (report.boundedness == reachability_type::unbounded) ==
+                !report.unbounded.empty();
+            ++infinite;
+            if (report.boundedness == reachability_type::unbounded)
+                ++detected;
+        };
+        if (!ok && ++failures <= 5)
+            printf("unbounded: mismatch in net %d\n", variant);
+    };
+    printf("unbounded: %d nets with large graphs, %d detected, "
+        "%d failures\n", infinite, detected, failures);
+    return failures == 0;
+}
+
+//      (splitmix64
+//   ,     )
+unsigned long long batch_random(
+    unsigned long long seed, unsigned long long rep, unsigned long long step)
+{
+    unsigned long long x = seed + rep * 0x9E3779B97F4A7C15ULL +
+        step * 0xD1B54A32D192ED03ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+//      
+//     
+bool check_batch(int count)
+{
+    const int replications = 70;
+    const long long limit = 200;
+    int failures = 0;
+    long long total = 0;
+    std::vector<int> dummy;
+    g_log = &dummy;
+    for (int variant = 1; variant <= count; ++variant)
+    {
+        hierarchy_type h;
+        make_hierarchy(h, variant);
+
+        long long terminated = 0, sum = 0, minsteps = -1, maxsteps = 0;
+        std::vector<long long> fired(h.transitions, 0);
+        for (int r = 0; r < replications; ++r)
+        {
+            model_type model(h);
+            model.activate();
+            long long step = 0;
+            std::vector<int> list;
+            for (; step < limit; ++step)
+            {
+                list.clear();
+                model.enabled(0, list);
+                if (list.empty())
+                    break;
+                int k = batch_random(variant, r, step) % list.size();
+                ++fired[list[k]];
+                model.fire(0, k);
+                dummy.clear();
+            };
+            if (!model.is_active())
+                ++terminated;
+            sum += step;
+            maxsteps = std::max(maxsteps, step);
+            if (minsteps < 0 || step < minsteps)
+                minsteps = step;
+        };
+
+        objects_type obj;
+        petrinet_type net(assemble(h, obj, 0));
+        batch_type batch(net);
+        for (int threads = 1; threads <= 3; threads += 2)
+        {
+            batch_type::report_type report =
+                batch.run(replications, variant, limit, threads);
+            bool ok = report.terminated == terminated &&
+                report.min_steps == minsteps &&
+                report.max_steps == maxsteps &&
+                (long long)(report.mean_steps * replications + 0.5) == sum;
+            batch_type::firedlist_type::const_iterator it;
+            for (it = report.fired.begin(); it != report.fired.end(); ++it)
+                ok = ok && it->second ==
+                    fired[obj.trindex.find(it->first)->second];
+            if (!ok && ++failures <= 5)
+                printf("batch: mismatch in net %d (%d threads)\n",
+                    variant, threads);
+        };
+        total += sum;
+    };
+    printf("batch: %d nets, %lld steps, %d failures\n",
+        count, total, failures);
+    return failures == 0;
+}
+
+// ------- , PNML    -------
+
+//   
+const char *g_snapfile = "zpetri-check.zpn";
+const char *g_checkfile = "zpetri-check.zcp";
+
+//      ,   
+// (       )
+bool same_image(
+    const petrinet_type &net, const objects_type &obj,
+    const petrinet_type &image, const snapshot_type &s)
+{
+    const transition_abstract_type::enabledlist_type &a = net.get_enabled();
+    const transition_abstract_type::enabledlist_type &b = image.get_enabled();
+    if (a.size() != b.size())
+        return false;
+    for (size_t k = 0; k < a.size(); ++k)
+        if (s.transition(obj.trindex.find(a[k])->second) != b[k])
+            return false;
+    for (int j = 0; j < s.places(); ++j)
+        if (net.get_tokens(const_cast<place_type *>(&obj.places[j])) !=
+            image.get_tokens(s.place(j)))
+            return false;
+    return true;
+}
+
+//           
+// ;   checkstep    
+//   ,    -  marking
+//     -1  
+int check_image(
+    petrinet_type &net, const objects_type &obj, petrinet_type &image,
+    const snapshot_type &s, unsigned seed, int steps, int checkstep,
+    std::vector<int> &marking)
+{
+    net.activate();
+    image.activate();
+    marking.clear();
+    int step = 0;
+    for (; step < steps; ++step)
+    {
+        if (!same_image(net, obj, image, s))
+            return -1;
+        if (step == checkstep || (marking.empty() && !net.is_active()))
+        {
+            if (!snapshot_type::checkpoint(g_checkfile, image))
+                return -1;
+            marking = image.get_marking();
+        };
+        if (!net.is_active())
+            break;
+        int number = pick(seed, net.get_enabled().size());
+        net.fire(number);
+        image.fire(number);
+    };
+    return step;
+}
+
+//        
+//   :      
+//  ,      
+bool check_restore(
+    const hierarchy_type &h, const snapshot_type &s,
+    const std::vector<int> &marking)
+{
+    petrinet_type image(s.image());
+    objects_type obj;
+    petrinet_type net(assemble(h, obj, 0));
+    image.activate();
+    net.activate();
+    if (!snapshot_type::restore(g_checkfile, image) ||
+        !snapshot_type::restore(g_checkfile, net) ||
+        image.get_marking() != marking || !same_image(net, obj, image, s))
+        return false;
+
+    //     
+    hierarchy_type other = h;
+    ++other.places;
+    ++other.nets[0].places;
+    other.nets[0].init.push_back(0);
+    for (int i = 0; i < other.nets[0].transitions; ++i)
+    {
+        other.nets[0].in[i].push_back(0);
+        other.nets[0].out[i].push_back(0);
+    };
+    objects_type otherobj;
+    petrinet_type othernet(assemble(other, otherobj, 0));
+    othernet.activate();
+    return !snapshot_type::restore(g_checkfile, othernet);
+}
+
+//     
+bool read_file(const char *filename, std::vector<char> &data)
+{
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+        return false;
+    data.clear();
+    int c;
+    while ((c = fgetc(file)) != EOF)
+        data.push_back(char(c));
+    fclose(file);
+    return true;
+}
+bool write_file(const char *filename, const std::vector<char> &data)
+{
+    FILE *file = fopen(filename, "wb");
+    if (!file)
+        return false;
+    bool ok = data.empty() ||
+        fwrite(&data[0], 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && ok;
+}
+
+//     
+int get_int(const std::vector<char> &data, size_t offset)
+{
+    int value;
+    memcpy(&value, &data[offset], sizeof(value));
+    return value;
+}
+void set_int(std::vector<char> &data, size_t offset, int value)
+{
+    memcpy(&data[offset], &value, sizeof(value));
+}
+
+//    : false,   ;
+//     ,     
+//  ( ,    
+// ,       )
+bool open_corrupted(const std::vector<char> &data, unsigned seed)
+{
+    snapshot_type s;
+    if (!write_file(g_snapfile, data) || !s.open(g_snapfile))
+        return false;
+    petrinet_type net(s.image());
+    net.activate();
+    bool small = true;
+    for (int step = 0; step < 100 && small && net.is_active(); ++step)
+    {
+        net.fire(pick(seed, net.get_enabled().size()));
+        for (int j = 0; j < s.places(); ++j)
+        {
+            int tokens = net.get_tokens(s.place(j));
+            assert(tokens >= 0);
+            small = small && tokens < (1 << 20);
+        };
+    };
+    return true;
+}
+
+//        ( 
+//         )
+void set_consumers(
+    std::vector<char> &data, size_t instart, size_t consstart,
+    int p, int t, int in)
+{
+    size_t inindex = instart + 4 * (t + 1), inweight = inindex + 4 * in;
+    size_t consindex = consstart + 4 * (p + 1);
+    size_t consweight = consindex + 4 * in;
+    std::vector<int> start(p + 1, 0);
+    for (int k = 0; k < in; ++k)
+        ++start[get_int(data, inindex + 4 * k) + 1];
+    for (int j = 0; j < p; ++j)
+        start[j + 1] += start[j];
+    for (int j = 0; j <= p; ++j)
+        set_int(data, consstart + 4 * j, start[j]);
+    for (int i = 0; i < t; ++i)
+    {
+        int last = get_int(data, instart + 4 * (i + 1));
+        for (int k = get_int(data, instart + 4 * i); k < last; ++k)
+        {
+            int pos = start[get_int(data, inindex + 4 * k)]++;
+            set_int(data, consindex + 4 * pos, i);
+            set_int(data, consweight + 4 * pos,
+                get_int(data, inweight + 4 * k));
+        };
+    };
+}
+
+//  :    
+// (. zpetri-snapshot.hxx)    ,
+//    -  ,    
+//     
+int check_corrupted(const std::vector<char> &data, unsigned seed)
+{
+    // : magic[8], version, byteorder, places, transitions,
+    // inarcs, outarcs, namebytes, reserved
+    const size_t header = 40;
+    int p = get_int(data, 16), t = get_int(data, 20);
+    int in = get_int(data, 24), out = get_int(data, 28);
+    size_t instart = header;
+    size_t inindex = instart + 4 * (t + 1);
+    size_t inweight = inindex + 4 * in;
+    size_t consstart = inweight + 4 * in + 4 * (t + 1 + 2 * out);
+    size_t consindex = consstart + 4 * (p + 1);
+    size_t marking = consindex + 8 * in;
+
+    std::vector<std::vector<char> > bad;
+    //     
+    bad.push_back(std::vector<char>(data.begin(), data.end() - 4));
+    bad.push_back(data);
+    set_int(bad.back(), 8, get_int(data, 8) + 1);
+    //      :   
+    //      
+    for (int i = 0; i < t; ++i)
+    {
+        int k = get_int(data, instart + 4 * i);
+        if (get_int(data, instart + 4 * (i + 1)) - k < 2)
+            continue;
+        bad.push_back(data);
+        set_int(bad.back(), inindex + 4 * (k + 1),
+            get_int(data, inindex + 4 * k));
+        bad.push_back(bad.back());
+        set_consumers(bad.back(), instart, consstart, p, t, in);
+        break;
+    };
+    if (in > 0)
+    {
+        //       
+        bad.push_back(data);
+        set_int(bad.back(), inweight, get_int(data, inweight) + 1);
+        //  -  
+        if (t > 1)
+        {
+            bad.push_back(data);
+            set_int(bad.back(), consindex,
+                (get_int(data, consindex) + 1) % t);
+        };
+    };
+    //  
+    if (p > 0)
+    {
+        bad.push_back(data);
+        set_int(bad.back(), marking, -1);
+    };
+    //     
+    bad.push_back(data);
+    bad.back().back() = 'x';
+
+    int accepted = 0;
+    for (size_t k = 0; k < bad.size(); ++k)
+        if (open_corrupted(bad[k], seed))
+            ++accepted;
+
+    //    
+    for (int k = 0; k < 20; ++k)
+    {
+        std::vector<char> copy = data;
+        for (int n = 1 + pick(seed, 3); n > 0; --n)
+            copy[header + pick(seed, copy.size() - header)] =
+                char(pick(seed, 256));
+        open_corrupted(copy, seed);
+    };
+    return accepted;
+}
+
+//           ,
+//      ,  
+//   
+bool check_snapshot(int count)
+{
+    int failures = 0;
+    long long total = 0;
+    std::vector<int> dummy;
+    g_log = &dummy;
+    for (int variant = 1; variant <= count; ++variant)
+    {
+        //     
+        hierarchy_type h;
+        unsigned seed = variant;
+        generate(h, seed, 0, 2 + pick(seed, 10), 1 + pick(seed, 10),
+            false);
+        objects_type obj;
+        petrinet_type net(assemble(h, obj, 0));
+        snapshot_type s;
+        bool ok = snapshot_type::save(g_snapfile, net) &&
+            s.open(g_snapfile) && s.places() == h.places &&
+            s.transitions() == h.transitions;
+        std::vector<char> data;
+        std::vector<int> marking;
+        if (ok)
+        {
+            petrinet_type image(s.image());
+            int steps = check_image(net, obj, image, s, variant, 300,
+                pick(seed, 100), marking);
+            ok = steps >= 0 && check_restore(h, s, marking) &&
+                read_file(g_snapfile, data);
+            total += steps;
+        };
+        s.close();
+        if (ok)
+            ok = check_corrupted(data, variant) == 0;
+        if (ok)
+        {
+            //   :  
+            //    
+            std::vector<char> check;
+            petrinet_type image(assemble(h, obj, 0));
+            image.activate();
+            ok = read_file(g_checkfile, check) && check.size() >= 4;
+            if (ok)
+            {
+                std::vector<char> copy = check;
+                set_int(copy, copy.size() - 4, -1);
+                ok = write_file(g_checkfile, copy) &&
+                    !snapshot_type::restore(g_checkfile, image);
+                copy = check;
+                copy.pop_back();
+                ok = ok && write_file(g_checkfile, copy) &&
+                    !snapshot_type::restore(g_checkfile, image);
+            };
+        };
+        if (!ok && ++failures <= 5)
+            printf("snapshot: mismatch in net %d\n", variant);
+    };
+
+    //       ,
+    //    
+    {
+        hierarchy_type h;
+        make_growing(h);
+        objects_type obj;
+        petrinet_type net(assemble(h, obj, 0));
+        net.activate();
+        bool ok = snapshot_type::checkpoint(g_checkfile, net);
+        net.fire(0);
+        ok = ok && !snapshot_type::checkpoint(g_checkfile, net) &&
+            !snapshot_type::restore(g_checkfile, net);
+        if (!ok && ++failures <= 5)
+            printf("snapshot: checkpoint of an active subnet\n");
+    }
+    std::remove(g_snapfile);
+    std::remove(g_checkfile);
+    printf("snapshot: %d nets, %lld steps, %d failures\n",
+        count, total, failures);
+    return failures == 0;
+}
+
+//  PNML     :   
+// ,    (     ), 
+//   ,     
+// ,    
+std::string make_pnml(const netdesc_type &desc, unsigned seed)
+{
+    std::string xml =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<!-- zpetri-check -->\n"
+        "<pnml xmlns=\"http://www.pnml.org/version-2009/grammar/pnml\">\n"
+        "<net id=\"net\" type=\"http://www.pnml.org/version-2009/"
+        "grammar/ptnet\">\n"
+        "<name><text>check &amp; net</text></name>\n"
+        "<page id=\"page\">\n";
+    char buf[256];
+    for (int j = 0; j < desc.places; ++j)
+    {
+        sprintf(buf, "<place id=\"p%d\"><name><text> &lt;p&gt; &amp; "
+            "&#x41F;&#1083;%d </text></name>", j, j);
+        xml += buf;
+        if (desc.init[j] > 0)
+        {
+            sprintf(buf, "<initialMarking><text>%d</text>"
+                "</initialMarking>", desc.init[j]);
+            xml += buf;
+        };
+        xml += "<graphics><position x=\"1\" y=\"2\"/></graphics></place>\n";
+    };
+    xml += "<page id=\"inner\">\n";
+    for (int i = 0; i < desc.transitions; ++i)
+    {
+        //      
+        if (pick(seed, 2))
+            sprintf(buf, "<transition id=\"t%d\"/>\n", i);
+        else
+            sprintf(buf, "<transition id=\"t%d\"><name><text>"
+                "<![CDATA[t%d]]></text></name></transition>\n", i, i);
+        xml += buf;
+    };
+    xml += "</page>\n</page>\n<page id=\"refs\">\n";
+    for (int j = 0; j < desc.places; ++j)
+    {
+        sprintf(buf, "<referencePlace id=\"rp%d\" ref=\"p%d\"/>"
+            "<referencePlace id=\"rrp%d\" ref=\"rp%d\"/>\n", j, j, j, j);
+        xml += buf;
+    };
+    for (int i = 0; i < desc.transitions; ++i)
+    {
+        sprintf(buf, "<referenceTransition id=\"rt%d\" ref=\"t%d\"/>\n",
+            i, i);
+        xml += buf;
+    };
+    const char *plprefix[] = {"p", "rp", "rrp"};
+    const char *trprefix[] = {"t", "rt"};
+    int arc = 0;
+    for (int i = 0; i < desc.transitions; ++i)
+    {
+        for (int j = 0; j < desc.places; ++j)
+        {
+            for (int dir = 0; dir < 2; ++dir)
+            {
+                int weight = dir == 0 ? desc.in[i][j] : desc.out[i][j];
+                while (weight > 0)
+                {
+                    int part = 1 + pick(seed, weight);
+                    weight -= part;
+                    char pl[32], tr[32];
+                    sprintf(pl, "%s%d", plprefix[pick(seed, 3)], j);
+                    sprintf(tr, "%s%d", trprefix[pick(seed, 2)], i);
+                    sprintf(buf, "<arc id=\"a%d\" source=\"%s\" "
+                        "target=\"%s\">", arc++, dir == 0 ? pl : tr,
+                        dir == 0 ? tr : pl);
+                    xml += buf;
+                    if (part > 1 || pick(seed, 2))
+                    {
+                        sprintf(buf, "<inscription><text> %d </text>"
+                            "</inscription>", part);
+                        xml += buf;
+                    };
+                    xml += "</arc>\n";
+                };
+            };
+        };
+    };
+    xml += "</page>\n</net>\n</pnml>\n";
+    return xml;
+}
+
+// ,   PNML    ,  
+//    ;   
+bool check_pnml(int count)
+{
+    int failures = 0;
+    long long total = 0;
+    std::vector<int> dummy;
+    g_log = &dummy;
+    for (int variant = 1; variant <= count; ++variant)
+    {
+        hierarchy_type h;
+        unsigned seed = variant;
+        generate(h, seed, 0, 2 + pick(seed, 10), 1 + pick(seed, 10),
+            false);
+        std::string xml = make_pnml(h.nets[0], variant);
+        pnml_reader_type reader;
+        std::istringstream in(xml);
+        snapshot_type s;
+        bool ok = reader.read(in) && reader.places() == h.places &&
+            reader.transitions() == h.transitions &&
+            reader.save(g_snapfile) && s.open(g_snapfile);
+        for (int j = 0; ok && j < h.places; ++j)
+        {
+            // "<p> & "  UTF-8
+            char name[64];
+            sprintf(name, "<p> & \xD0\x9F\xD0\xBB%d", j);
+            ok = strcmp(s.place_name(j), name) == 0;
+        };
+        for (int i = 0; ok && i < h.transitions; ++i)
+        {
+            char name[32];
+            sprintf(name, "t%d", i);
+            ok = strcmp(s.transition_name(i), name) == 0;
+        };
+        if (ok)
+        {
+            objects_type obj;
+            petrinet_type net(assemble(h, obj, 0));
+            petrinet_type image(s.image());
+            std::vector<int> marking;
+            int steps = check_image(net, obj, image, s, variant, 300, -1,
+                marking);
+            ok = steps >= 0;
+            total += steps;
+        };
+        s.close();
+
+        //  : ,   
+        //  ,   ,    
+        //     
+        const char *from[] = {
+            "</pnml>", "&amp;", "<inscription><text> ", "</net>", "</net>"};
+        const char *to[] = {
+            "", "&foo;", "<inscription><text> -",
+            "<arc id=\"x\" source=\"rrp0\" target=\"nowhere\"/></net>",
+            "<referencePlace id=\"x\" ref=\"y\"/>"
+            "<referencePlace id=\"y\" ref=\"x\"/>"
+            "<arc id=\"z\" source=\"x\" target=\"t0\"/></net>"};
+        for (int k = 0; ok && k < 5; ++k)
+        {
+            std::string copy = xml;
+            size_t pos = copy.find(from[k]);
+            if (pos == std::string::npos)
+                continue;
+            copy.replace(pos, strlen(from[k]), to[k]);
+            std::istringstream corrupted(copy);
+            ok = !reader.read(corrupted) && !reader.error().empty();
+        };
+        if (!ok && ++failures <= 5)
+            printf("pnml: mismatch in net %d\n", variant);
+    };
+    std::remove(g_snapfile);
+    std::remove(g_checkfile);
+    printf("pnml: %d nets, %lld steps, %d failures\n",
+        count, total, failures);
+    return failures == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : 2000;
+    if (count <= 0)
+        count = 2000;
+
+    bool ok = true;
+    ok = check_incremental(count) && ok;
+    ok = check_flat(count) && ok;
+    ok = check_reach(count) && ok;
+    ok = check_unbounded(count) && ok;
+    ok = check_batch(count) && ok;
+    ok = check_snapshot(count) && ok;
+    ok = check_pnml(count) && ok;
+
+    return ok ? 0 : 1;
+}
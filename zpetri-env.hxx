@@ -26,14 +26,18 @@
 #include <map>
 #include <utility>
 #include <cstdlib>
-#include <windows.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include "zpetri.hxx"
+#include "zpetri-monitor.hxx"
 
 namespace z {
 namespace petri {
 
 //      
-class randomenv_type: public petrinet_type::environment_abstract_type
+class randomenv_type: public petrinet_type::environment_view_abstract_type
 {
 public:
     //      [0, bound)
@@ -45,14 +49,16 @@ public:
     }
     //   
     int wait(
-        const petrinet_type::enabledlist_type &enabled,
-        const petrinet_type::markedlist_type &marked)
+        const enabledview_type &enabled,
+        const markedview_type &)
     {
         return random(enabled.size());
     }
 };
 
 //      
+//       
+//  ,     
 class threadenv_type: public randomenv_type
 {
 public:
@@ -66,6 +72,15 @@ public:
     };
 
 private:
+    //      
+    // (      )
+    static
+    const void *stop_tag(void)
+    {
+        static const char tag = 0;
+        return &tag;
+    }
+
     //    
     class transition_stop_type: public transition_simple_type
     {
@@ -73,15 +88,46 @@ private:
         //    
         int m_id;
     public:
-        transition_stop_type(int id): m_id(id) {}
+        transition_stop_type(int id): m_id(id) { set_tag(stop_tag()); }
         int id(void) const { return m_id; }
     };
 
-    //   
-    struct threadparam_type
+    //      
+    // (        , 
+    //         )
+    class jobqueue_type
     {
-        //    
-        longjob_abstract_type *pjob;
+    private:
+        std::vector<int> m_items;
+        size_t m_head, m_count;
+    public:
+        jobqueue_type(): m_head(0), m_count(0) {}
+        //      
+        void reserve(size_t n)
+        {
+            std::vector<int> items(n);
+            for (size_t i = 0; i < m_count; ++i)
+                items[i] = m_items[(m_head + i) % m_items.size()];
+            m_items.swap(items);
+            m_head = 0;
+        }
+        bool empty(void) const
+        {
+            return m_count == 0;
+        }
+        void push(int id)
+        {
+            assert(m_count < m_items.size());
+            m_items[(m_head + m_count++) % m_items.size()] = id;
+        }
+        int pop(void)
+        {
+            assert(m_count > 0);
+            int id = m_items[m_head];
+            m_head = (m_head + 1) % m_items.size();
+            --m_count;
+            return id;
+        }
     };
 
     //  ,     
@@ -90,12 +136,10 @@ private:
         //    
         place_type started, stopped;
         transition_stop_type stop;
-        //    
-        HANDLE thread;
-        //  
-        threadparam_type param;
+        //    
+        longjob_abstract_type *pjob;
         // 
-        jobdata_type(int id, const threadparam_type &p): stop(id), param(p) {}
+        jobdata_type(int id, longjob_abstract_type *p): stop(id), pjob(p) {}
     };
 
 public:
@@ -149,33 +193,76 @@ private:
     //       
     std::deque<jobdata_type> m_alljobdata;
 
-    //   -     
-    static
-    DWORD WINAPI thr_proc(LPVOID param)
+    //  
+    std::vector<std::thread> m_workers;
+    //      
+    std::mutex m_mutex;
+    //       
+    std::condition_variable m_jobready;
+    //      wait
+    std::condition_variable m_jobdone;
+    //  ,  
+    jobqueue_type m_pending;
+    //       
+    jobqueue_type m_completed;
+    //    
+    bool m_shutdown;
+    // ,    (0,   )
+    monitor_type *m_monitor;
+    //       , 
+    //       
+    // (   )
+    int m_running;
+
+    //    -    
+    void worker(void)
     {
-        threadparam_type &p = *static_cast<threadparam_type *>(param);
-        //  
-        p.pjob->run();
-        return 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            while (!m_shutdown && m_pending.empty())
+                m_jobready.wait(lock);
+            if (m_pending.empty())
+                break;
+            int id = m_pending.pop();
+            longjob_abstract_type *pjob = m_alljobdata[id].pjob;
+            monitor_type *monitor = m_monitor;
+
+            //  
+            lock.unlock();
+            if (monitor)
+            {
+                std::chrono::steady_clock::time_point start =
+                    std::chrono::steady_clock::now();
+                pjob->run();
+                monitor->on_job(pjob, std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start).count());
+            }
+            else
+                pjob->run();
+            lock.lock();
+
+            //   
+            m_completed.push(id);
+            m_jobdone.notify_one();
+        };
     }
 
     //   
     void initialize_longjob(int id)
     {
-        //  
-        DWORD dwId;
-        m_alljobdata[id].thread = ::CreateThread(
-            NULL, 0,
-            thr_proc, &m_alljobdata[id].param,
-            0, &dwId);
-        assert(m_alljobdata[id].thread != NULL);
+        ++m_running;
+        //     
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.push(id);
+        m_jobready.notify_one();
     }
     //     
-    void finalize_longjob(int id)
+    void finalize_longjob(int)
     {
-        //  
-        //       
-        ::CloseHandle(m_alljobdata[id].thread);
+        //      
+        //     ,   
+        --m_running;
     }
 
     //     
@@ -183,72 +270,79 @@ private:
     std::pair<int, jobdata_type *> allocate_longjob(
         longjob_abstract_type &longjob)
     {
+        std::lock_guard<std::mutex> lock(m_mutex);
         //    
         int id = m_alljobdata.size();
-
-        //    
-        threadparam_type param = {};
-        param.pjob = &longjob;
         //    
-        m_alljobdata.push_back(jobdata_type(id, param));
+        m_alljobdata.push_back(jobdata_type(id, &longjob));
+        m_pending.reserve(m_alljobdata.size());
+        m_completed.reserve(m_alljobdata.size());
         //        
         return std::make_pair(id, &m_alljobdata.back());
     }
 
 public:
+    // ,    
+    // (  -    )
+    explicit
+    threadenv_type(int threads = 0):
+        m_shutdown(false), m_monitor(0), m_running(0)
+    {
+        if (threads <= 0)
+            threads = std::thread::hardware_concurrency();
+        if (threads <= 0)
+            threads = 1;
+        for (int i = 0; i < threads; ++i)
+            m_workers.push_back(std::thread(&threadenv_type::worker, this));
+    }
+    // ,    
+    ~threadenv_type()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_shutdown = true;
+            m_jobready.notify_all();
+        }
+        for (size_t i = 0; i < m_workers.size(); ++i)
+            m_workers[i].join();
+    }
+
+    //      (0 - )
+    void set_monitor(monitor_type *monitor)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_monitor = monitor;
+    }
+
     //   
+    //     : 
+    //     (  size / free
+    // ),        
     int wait(
-        const petrinet_type::enabledlist_type &enabled,
-        const petrinet_type::markedlist_type &marked)
+        const enabledview_type &enabled,
+        const markedview_type &)
     {
-        //    
-        // busy -   ,    
-        // finished -   ,   
-        // free - ,     
-        std::vector<int> busy, finished, free;
-        //  ,    
-        std::vector<HANDLE> hdls;
-        //     
-        petrinet_type::enabledlist_type::const_iterator it;
-        for (it = enabled.begin(); it != enabled.end(); ++it)
+        std::unique_lock<std::mutex> lock(m_mutex);
+        //    ,    ,
+        //     
+        if (m_completed.empty() && enabled.size() > m_running)
         {
-            transition_stop_type *stop = dynamic_cast<transition_stop_type *>(*it);
-            //      ,    
-            if (!stop)
-                free.push_back(std::distance(enabled.begin(), it));
-            else
+            lock.unlock();
+            for (;;)
             {
-                //     
-                HANDLE hdl = m_alljobdata[stop->id()].thread;
-                //  ,   
-                if (::WaitForSingleObject(hdl, 0) == WAIT_OBJECT_0)
-                    finished.push_back(std::distance(enabled.begin(), it));
-                else
-                {
-                    //   ,    
-                    busy.push_back(std::distance(enabled.begin(), it));
-                    hdls.push_back(hdl);
-                };
+                int i = random(enabled.size());
+                if (enabled[i]->tag() != stop_tag())
+                    return i;
             };
         };
-        //      
-        int rc;
-        //    , 
-        //     
-        if (!finished.empty())
-            rc = finished[random(finished.size())];
-        //    ,     
-        else if (!free.empty())
-            rc = free[random(free.size())];
-        else
-        {
-            //        
-            DWORD dw = ::WaitForMultipleObjects(
-                hdls.size(), &hdls.front(), FALSE, INFINITE);
-            assert(dw >= WAIT_OBJECT_0 && dw < WAIT_OBJECT_0 + hdls.size());
-            //     
-            rc = busy[dw - WAIT_OBJECT_0];
-        };
+        //        
+        while (m_completed.empty())
+            m_jobdone.wait(lock);
+        //       
+        int id = m_completed.pop();
+        int rc = enabled.find(&m_alljobdata[id].stop);
+        assert(rc >= 0 && rc < enabled.size() &&
+            enabled[rc] == &m_alljobdata[id].stop);
         return rc;
     }
 };
@@ -0,0 +1,421 @@
+/* ------------------------------------------------------------------------- */
+/*        ,                  */
+/*     :                              */
+/*   ..                                                             */
+/*    . - .: -, 2012. - 384 . */
+/*  ISBN 978-5-91359-102-9                                                   */
+/*                                                                           */
+/*     ,           */
+/*                   */
+/*   ,      .  */
+/*                   */
+/*  ,                 */
+/*       .                                     */
+/*     " ",            */
+/*         .       */
+/*                                                                           */
+/*  Copyright  2008-2011  ..                                       */
+/* ------------------------------------------------------------------------- */
+
+
+#ifndef _ZPETRI_FLAT_HXX_
+#define _ZPETRI_FLAT_HXX_
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cassert>
+#include "zpetri.hxx"
+
+namespace z {
+namespace petri {
+
+//  ,    
+// :         ,
+//    -  ,  
+//    ,    ( 
+//  on_activate/on_passivate)
+class flatnet_type: public marking_abstract_type
+{
+    //   
+    friend class reachability_type;
+    //  
+    friend class batch_type;
+
+public:
+    typedef transition_abstract_type::enabledlist_type enabledlist_type;
+
+private:
+    typedef transition_compound_type::arcmatrix_type arcmatrix_type;
+    typedef std::vector<int> marking_type;
+
+    // -------  (   ) -------
+
+    //  
+    std::vector<place_type *> m_plptr;
+    //     
+    std::map<place_type *, int> m_plindex;
+    //    
+    marking_type m_marking_init;
+    //  ,     
+    arcmatrix_type m_consumers;
+
+    // -------  (     ) -------
+
+    //  
+    std::vector<transition_abstract_type *> m_trptr;
+    //     
+    std::map<const transition_abstract_type *, int> m_trindex;
+    //  ,   
+    std::vector<int> m_trnet;
+    //     (-1  )
+    std::vector<int> m_trchild;
+    //      (   )
+    arcmatrix_type m_mtxin;
+    arcmatrix_type m_mtxout;
+
+    // -------  (0 -   ) -------
+
+    //  ,   (-1    )
+    std::vector<int> m_netowner;
+    //     (  )
+    std::vector<int> m_netplace;
+    //        
+    // (    -)
+    std::vector<int> m_netlast;
+    //     
+    arcmatrix_type m_nettrans;
+
+    // -------  -------
+
+    //  
+    marking_type m_marking;
+    //    
+    std::vector<char> m_active;
+    //     
+    // (       )
+    std::vector<int> m_enabled;
+    //    
+    enabledlist_type m_enabledptr;
+    //     m_enabled  
+    //      
+    std::vector<char> m_listed;
+    // ,     
+    //  m_enabled (,  )
+    std::vector<int> m_pending;
+    //    m_enabled
+    std::vector<int> m_buffer;
+    //   ,  
+    // (   )
+    indexset_type m_marked;
+
+    //        
+    void compile(const transition_compound_type &tr, int owner)
+    {
+        const transition_compound_type::image_type &a = tr.net();
+
+        //     
+        int net = m_netowner.size();
+        int base = m_plptr.size();
+        m_netowner.push_back(owner);
+        m_netplace.push_back(base);
+        m_netlast.push_back(0);
+        m_plptr.insert(m_plptr.end(), a.pllist, a.pllist + a.places);
+        m_marking_init.insert(m_marking_init.end(),
+            a.marking, a.marking + a.places);
+
+        //   ,    -  
+        for (int i = 0; i < tr.tr_num(); ++i)
+        {
+            int id = m_trptr.size();
+            m_trptr.push_back(a.trlist[i]);
+            m_trnet.push_back(net);
+            m_trchild.push_back(-1);
+            for (int k = a.instart[i]; k < a.instart[i + 1]; ++k)
+            {
+                m_mtxin.index.push_back(base + a.inindex[k]);
+                m_mtxin.weight.push_back(a.inweight[k]);
+            };
+            m_mtxin.start.push_back(m_mtxin.index.size());
+            for (int k = a.outstart[i]; k < a.outstart[i + 1]; ++k)
+            {
+                m_mtxout.index.push_back(base + a.outindex[k]);
+                m_mtxout.weight.push_back(a.outweight[k]);
+            };
+            m_mtxout.start.push_back(m_mtxout.index.size());
+
+            //  ,   ,  
+            const transition_compound_type *child =
+                dynamic_cast<const transition_compound_type *>(a.trlist[i]);
+            if (child)
+            {
+                m_trchild[id] = m_netowner.size();
+                compile(*child, id);
+            };
+        };
+        m_netlast[net] = m_trptr.size();
+    }
+
+    //        
+    // (  m_pending    )
+    int net_enabled(int net) const
+    {
+        int first = m_netowner[net] + 1;
+        return std::lower_bound(
+                m_enabled.begin(), m_enabled.end(), m_netlast[net]) -
+            std::lower_bound(m_enabled.begin(), m_enabled.end(), first);
+    }
+
+    // ,    
+    bool is_enabled(int t) const
+    {
+        for (int k = m_mtxin.start[t]; k < m_mtxin.start[t + 1]; ++k)
+            if (m_marking[m_mtxin.index[k]] < m_mtxin.weight[k])
+                return false;
+        return true;
+    }
+
+    //      :
+    // ,    , 
+    // ,      m_pending
+    void update(int t)
+    {
+        bool enabled = !m_active[t] && is_enabled(t);
+        if (enabled == bool(m_listed[t]))
+            return;
+        m_listed[t] = enabled;
+        m_pending.push_back(t);
+    }
+
+    //       
+    void apply_pending(void)
+    {
+        if (m_pending.empty())
+            return;
+        //      
+        if (m_pending.size() == 1)
+        {
+            int t = m_pending[0];
+            std::vector<int>::iterator it =
+                std::lower_bound(m_enabled.begin(), m_enabled.end(), t);
+            int pos = it - m_enabled.begin();
+            if (m_listed[t])
+            {
+                m_enabled.insert(it, t);
+                m_enabledptr.insert(m_enabledptr.begin() + pos, m_trptr[t]);
+            }
+            else
+            {
+                m_enabled.erase(it);
+                m_enabledptr.erase(m_enabledptr.begin() + pos);
+            };
+            m_pending.clear();
+            return;
+        };
+        //        
+        //      
+        std::sort(m_pending.begin(), m_pending.end());
+        m_pending.erase(std::unique(m_pending.begin(), m_pending.end()),
+            m_pending.end());
+        int first = std::lower_bound(m_enabled.begin(), m_enabled.end(),
+            m_pending[0]) - m_enabled.begin();
+        std::vector<int>::const_iterator it = m_enabled.begin() + first;
+        std::vector<int>::const_iterator pt = m_pending.begin();
+        m_buffer.clear();
+        while (it != m_enabled.end() || pt != m_pending.end())
+        {
+            int t;
+            if (pt == m_pending.end() || (it != m_enabled.end() && *it < *pt))
+                t = *it++;
+            else
+            {
+                //       
+                if (it != m_enabled.end() && *it == *pt)
+                    ++it;
+                t = *pt++;
+            };
+            if (m_listed[t])
+                m_buffer.push_back(t);
+        };
+        m_enabled.resize(first);
+        m_enabled.insert(m_enabled.end(), m_buffer.begin(), m_buffer.end());
+        m_enabledptr.resize(first);
+        for (size_t k = 0; k < m_buffer.size(); ++k)
+            m_enabledptr.push_back(m_trptr[m_buffer[k]]);
+        m_pending.clear();
+    }
+
+    //       
+    void change_marking(int j, int delta)
+    {
+        m_marking[j] += delta;
+        m_marked.assign(j, m_marking[j] > 0);
+        for (int k = m_consumers.start[j]; k < m_consumers.start[j + 1]; ++k)
+            update(m_consumers.index[k]);
+    }
+
+    //  :     
+    void activate_net(int net)
+    {
+        for (int j = m_netplace[net]; j < m_netplace[net + 1]; ++j)
+        {
+            m_marking[j] = m_marking_init[j];
+            m_marked.assign(j, m_marking[j] > 0);
+        };
+        for (int k = m_nettrans.start[net]; k < m_nettrans.start[net + 1]; ++k)
+        {
+            int t = m_nettrans.index[k];
+            m_active[t] = false;
+            update(t);
+        };
+    }
+
+    //  :      
+    void passivate_net(int net)
+    {
+        for (int j = m_netplace[net]; j < m_netplace[net + 1]; ++j)
+        {
+            m_marking[j] = 0;
+            m_marked.assign(j, false);
+        };
+    }
+
+public:
+    //        
+    // (     , 
+    //   )
+    explicit
+    flatnet_type(const transition_compound_type &root)
+    {
+        m_mtxin.start.push_back(0);
+        m_mtxout.start.push_back(0);
+        compile(root, -1);
+        m_netplace.push_back(m_plptr.size());
+
+        m_consumers = transition_compound_type::transpose(
+            m_mtxin, m_plptr.size());
+        //    -  
+        //   
+        arcmatrix_type trnet;
+        for (int t = 0; t <= int(m_trnet.size()); ++t)
+            trnet.start.push_back(t);
+        trnet.index = m_trnet;
+        trnet.weight.assign(m_trnet.size(), 1);
+        m_nettrans = transition_compound_type::transpose(
+            trnet, m_netowner.size());
+
+        for (size_t j = 0; j < m_plptr.size(); ++j)
+            m_plindex[m_plptr[j]] = j;
+        for (size_t t = 0; t < m_trptr.size(); ++t)
+            m_trindex[m_trptr[t]] = t;
+        m_marking.assign(m_plptr.size(), 0);
+        m_active.assign(m_trptr.size(), false);
+        m_listed.assign(m_trptr.size(), false);
+    }
+
+    void activate(void)
+    {
+        m_enabled.clear();
+        m_enabledptr.clear();
+        m_listed.assign(m_trptr.size(), false);
+        m_pending.clear();
+        m_marking.assign(m_plptr.size(), 0);
+        m_marked.reset(m_plptr.size());
+        m_active.assign(m_trptr.size(), false);
+        activate_net(0);
+        apply_pending();
+    }
+    bool is_active(void) const
+    {
+        return !m_enabled.empty();
+    }
+    const enabledlist_type &get_enabled(void) const
+    {
+        return m_enabledptr;
+    }
+    markedlist_type get_marked(void) const
+    {
+        markedlist_type marked;
+        std::vector<int>::const_iterator it;
+        for (it = m_marked.items().begin(); it != m_marked.items().end(); ++it)
+            marked[m_plptr[*it]] = m_marking[*it];
+        return marked;
+    }
+    int get_tokens(place_type *pl) const
+    {
+        std::map<place_type *, int>::const_iterator ft = m_plindex.find(pl);
+        return (ft != m_plindex.end()) ? m_marking[ft->second] : 0;
+    }
+    int locate(const transition_abstract_type *tr) const
+    {
+        //      
+        std::map<const transition_abstract_type *, int>::const_iterator ft =
+            m_trindex.find(tr);
+        if (ft == m_trindex.end() || !m_listed[ft->second])
+            return -1;
+        std::vector<int>::const_iterator it = std::lower_bound(
+            m_enabled.begin(), m_enabled.end(), ft->second);
+        return (it != m_enabled.end() && *it == ft->second) ?
+            int(it - m_enabled.begin()) : -1;
+    }
+    void fire(int number)
+    {
+        assert(number >= 0 && size_t(number) < m_enabled.size());
+
+        int t = m_enabled[number];
+        //   
+        for (int k = m_mtxin.start[t]; k < m_mtxin.start[t + 1]; ++k)
+            change_marking(m_mtxin.index[k], -m_mtxin.weight[k]);
+        //  
+        m_trptr[t]->on_activate();
+        if (m_trchild[t] >= 0)
+        {
+            activate_net(m_trchild[t]);
+            apply_pending();
+            m_active[t] = (net_enabled(m_trchild[t]) > 0);
+            update(t);
+        };
+
+        //   , ,   
+        for (int cur = t; !m_active[cur]; )
+        {
+            m_trptr[cur]->on_passivate();
+            if (m_trchild[cur] >= 0)
+                passivate_net(m_trchild[cur]);
+            //   
+            for (int k = m_mtxout.start[cur]; k < m_mtxout.start[cur + 1]; ++k)
+                change_marking(m_mtxout.index[k], m_mtxout.weight[k]);
+            update(cur);
+
+            //    ,
+            //       
+            int net = m_trnet[cur];
+            cur = m_netowner[net];
+            apply_pending();
+            if (cur < 0 || net_enabled(net) > 0)
+                break;
+            m_active[cur] = false;
+        };
+        apply_pending();
+    }
+
+    //      
+    void live(petrinet_type::environment_abstract_type &env)
+    {
+        activate();
+        while (is_active())
+            fire(env.wait(get_enabled(), get_marked()));
+    }
+    void live(petrinet_type::environment_view_abstract_type &env)
+    {
+        activate();
+        while (is_active())
+            fire(env.wait(enabledview_type(m_enabledptr, *this),
+                markedview_type(*this)));
+    }
+};
+
+} // namespace petri
+} // namespace z
+
+#endif /* _ZPETRI_FLAT_HXX_ */
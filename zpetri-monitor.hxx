@@ -0,0 +1,303 @@
+/* ------------------------------------------------------------------------- */
+/*        ,                  */
+/*     :                              */
+/*   ..                                                             */
+/*    . - .: -, 2012. - 384 . */
+/*  ISBN 978-5-91359-102-9                                                   */
+/*                                                                           */
+/*     ,           */
+/*                   */
+/*   ,      .  */
+/*                   */
+/*  ,                 */
+/*       .                                     */
+/*     " ",            */
+/*         .       */
+/*                                                                           */
+/*  Copyright  2008-2011  ..                                       */
+/* ------------------------------------------------------------------------- */
+
+
+#ifndef _ZPETRI_MONITOR_HXX_
+#define _ZPETRI_MONITOR_HXX_
+
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <string>
+#include <sstream>
+#include <ostream>
+#include <algorithm>
+#include <mutex>
+#include <chrono>
+#include "zpetri.hxx"
+
+namespace z {
+namespace petri {
+
+// ,     :
+//    ,  
+//        ;
+//     CSV  JSON
+class monitor_type: public petrinet_type::monitor_abstract_type
+{
+public:
+    //    
+    // ( k > 0  [2^(k-1), 2^k) )
+    static const int buckets = 48;
+
+private:
+    typedef std::chrono::steady_clock clock_type;
+
+    //    
+    struct jobstat_type
+    {
+        long long count;
+        double total, min, max;
+    };
+
+    //      
+    std::map<const void *, std::string> m_names;
+    //   
+    std::unordered_map<transition_abstract_type *, long long> m_fired;
+    //   
+    long long m_wait[buckets];
+    //  :   m_period- 
+    // (     )
+    int m_period;
+    //     
+    int m_countdown;
+    //    (  )
+    bool m_timing;
+    clock_type::time_point m_waitstart;
+    //   (   )
+    std::map<const void *, jobstat_type> m_jobs;
+    mutable std::mutex m_jobmutex;
+
+    //       
+    static
+    int bucket(long long ns)
+    {
+        int k = 0;
+        while (ns > 0 && k < buckets - 1)
+        {
+            ns >>= 1;
+            ++k;
+        };
+        return k;
+    }
+    //      
+    static
+    long long bucket_from(int k)
+    {
+        return k > 0 ? 1LL << (k - 1) : 0;
+    }
+    static
+    long long bucket_to(int k)
+    {
+        return 1LL << k;
+    }
+
+    //     (,    )
+    std::string name(const void *object) const
+    {
+        std::map<const void *, std::string>::const_iterator it =
+            m_names.find(object);
+        if (it != m_names.end())
+            return it->second;
+        std::ostringstream os;
+        os << object;
+        return os.str();
+    }
+    //   CSV (    )
+    static
+    std::string csv_field(const std::string &str)
+    {
+        if (str.find_first_of(",\"\r\n") == std::string::npos)
+            return str;
+        std::string res = "\"";
+        for (size_t i = 0; i < str.size(); ++i)
+        {
+            if (str[i] == '"')
+                res += '"';
+            res += str[i];
+        };
+        return res + "\"";
+    }
+    //    JSON (,   
+    //   )
+    static
+    std::string quote(const std::string &str)
+    {
+        static const char hex[] = "0123456789abcdef";
+        std::string res = "\"";
+        for (size_t i = 0; i < str.size(); ++i)
+        {
+            unsigned char c = str[i];
+            if (c == '"' || c == '\\')
+            {
+                res += '\\';
+                res += c;
+            }
+            else if (c == '\n')
+                res += "\\n";
+            else if (c == '\r')
+                res += "\\r";
+            else if (c == '\t')
+                res += "\\t";
+            else if (c < 0x20)
+            {
+                //    -   \u00XX
+                res += "\\u00";
+                res += hex[c >> 4];
+                res += hex[c & 0xf];
+            }
+            else
+                res += c;
+        };
+        return res + "\"";
+    }
+
+    //      
+    std::vector<std::pair<long long, transition_abstract_type *> >
+        sorted_fired(void) const
+    {
+        std::vector<std::pair<long long, transition_abstract_type *> > res;
+        std::unordered_map<transition_abstract_type *, long long>::
+            const_iterator it;
+        for (it = m_fired.begin(); it != m_fired.end(); ++it)
+            res.push_back(std::make_pair(-it->second, it->first));
+        std::sort(res.begin(), res.end());
+        return res;
+    }
+
+public:
+    // ,    
+    // (1 -   )
+    explicit
+    monitor_type(int period = 64): m_period(period > 0 ? period : 1)
+    {
+        reset();
+    }
+
+    //       
+    void set_name(const void *object, const std::string &name)
+    {
+        m_names[object] = name;
+    }
+    //   
+    void reset(void)
+    {
+        m_fired.clear();
+        std::fill(m_wait, m_wait + buckets, 0);
+        m_countdown = 1;
+        m_timing = false;
+        std::lock_guard<std::mutex> lock(m_jobmutex);
+        m_jobs.clear();
+    }
+
+    // -------   -------
+
+    void on_wait_begin(void)
+    {
+        if (--m_countdown > 0)
+            return;
+        m_countdown = m_period;
+        m_timing = true;
+        m_waitstart = clock_type::now();
+    }
+    void on_wait_end(void)
+    {
+        if (!m_timing)
+            return;
+        m_timing = false;
+        ++m_wait[bucket(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            clock_type::now() - m_waitstart).count())];
+    }
+    void on_fire(transition_abstract_type *tr)
+    {
+        ++m_fired[tr];
+    }
+    //     (   )
+    void on_job(const void *job, double seconds)
+    {
+        std::lock_guard<std::mutex> lock(m_jobmutex);
+        std::map<const void *, jobstat_type>::iterator it = m_jobs.find(job);
+        if (it == m_jobs.end())
+        {
+            jobstat_type stat = { 1, seconds, seconds, seconds };
+            m_jobs[job] = stat;
+        }
+        else
+        {
+            ++it->second.count;
+            it->second.total += seconds;
+            it->second.min = std::min(it->second.min, seconds);
+            it->second.max = std::max(it->second.max, seconds);
+        };
+    }
+
+    // -------   -------
+
+    //    CSV:  ,     
+    // (fire -  , wait -  
+    //  , job -  )
+    void write_csv(std::ostream &os) const
+    {
+        os << "kind,name,count,from_ns,to_ns,total_s,min_s,max_s\n";
+        std::vector<std::pair<long long, transition_abstract_type *> >
+            fired = sorted_fired();
+        for (size_t i = 0; i < fired.size(); ++i)
+            os << "fire," << csv_field(name(fired[i].second)) << ","
+                << -fired[i].first << ",,,,,\n";
+        for (int k = 0; k < buckets; ++k)
+            if (m_wait[k] > 0)
+                os << "wait,," << m_wait[k] << "," << bucket_from(k) << ","
+                    << bucket_to(k) << ",,,\n";
+        std::lock_guard<std::mutex> lock(m_jobmutex);
+        std::map<const void *, jobstat_type>::const_iterator it;
+        for (it = m_jobs.begin(); it != m_jobs.end(); ++it)
+            os << "job," << csv_field(name(it->first)) << "," << it->second.count
+                << ",,," << it->second.total << "," << it->second.min
+                << "," << it->second.max << "\n";
+    }
+
+    //    JSON
+    void write_json(std::ostream &os) const
+    {
+        os << "{\n  \"fired\": [";
+        std::vector<std::pair<long long, transition_abstract_type *> >
+            fired = sorted_fired();
+        for (size_t i = 0; i < fired.size(); ++i)
+            os << (i ? "," : "") << "\n    {\"name\": "
+                << quote(name(fired[i].second))
+                << ", \"count\": " << -fired[i].first << "}";
+        os << "\n  ],\n  \"wait\": [";
+        bool first = true;
+        for (int k = 0; k < buckets; ++k)
+        {
+            if (m_wait[k] == 0)
+                continue;
+            os << (first ? "" : ",") << "\n    {\"from_ns\": "
+                << bucket_from(k) << ", \"to_ns\": " << bucket_to(k)
+                << ", \"count\": " << m_wait[k] << "}";
+            first = false;
+        };
+        os << "\n  ],\n  \"jobs\": [";
+        std::lock_guard<std::mutex> lock(m_jobmutex);
+        std::map<const void *, jobstat_type>::const_iterator it;
+        for (it = m_jobs.begin(); it != m_jobs.end(); ++it)
+            os << (it == m_jobs.begin() ? "" : ",") << "\n    {\"name\": "
+                << quote(name(it->first))
+                << ", \"count\": " << it->second.count
+                << ", \"total_s\": " << it->second.total
+                << ", \"min_s\": " << it->second.min
+                << ", \"max_s\": " << it->second.max << "}";
+        os << "\n  ]\n}\n";
+    }
+};
+
+} // namespace petri
+} // namespace z
+
+#endif /* _ZPETRI_MONITOR_HXX_ */
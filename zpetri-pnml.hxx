@@ -0,0 +1,557 @@
+/* ------------------------------------------------------------------------- */
+/*        ,                  */
+/*     :                              */
+/*   ..                                                             */
+/*    . - .: -, 2012. - 384 . */
+/*  ISBN 978-5-91359-102-9                                                   */
+/*                                                                           */
+/*     ,           */
+/*                   */
+/*   ,      .  */
+/*                   */
+/*  ,                 */
+/*       .                                     */
+/*     " ",            */
+/*         .       */
+/*                                                                           */
+/*  Copyright  2008-2011  ..                                       */
+/* ------------------------------------------------------------------------- */
+
+
+#ifndef _ZPETRI_PNML_HXX_
+#define _ZPETRI_PNML_HXX_
+
+#include <vector>
+#include <map>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <istream>
+#include <cstdlib>
+#include "zpetri.hxx"
+#include "zpetri-snapshot.hxx"
+
+namespace z {
+namespace petri {
+
+//   /   PNML (XML)   
+//   ;   ,   ,
+//      
+//
+//   place, transition  arc   ,
+//   (name/text),   (initialMarking/text),
+//   (inscription/text)    referencePlace
+//  referenceTransition;   
+class pnml_reader_type
+{
+private:
+    //    
+    enum kind_type { kind_none, kind_place, kind_transition, kind_arc };
+
+    //  :      
+    struct node_type
+    {
+        kind_type kind;
+        int index;
+    };
+    //    
+    struct arcref_type
+    {
+        std::string source, target;
+        int weight;
+    };
+    //   :    
+    struct arc_type
+    {
+        int pl, tr, weight;
+    };
+    typedef std::map<std::string, std::string> attrlist_type;
+
+    //   
+    std::map<std::string, node_type> m_nodes;
+    //  :  -  ,  
+    //  
+    std::map<std::string, std::string> m_refs;
+    //     ,  
+    std::vector<std::string> m_plnames, m_trnames;
+    std::vector<int> m_marking;
+    //    
+    std::vector<arcref_type> m_arcrefs;
+    std::vector<arc_type> m_inarcs, m_outarcs;
+
+    //    (   )
+    std::vector<std::string> m_stack;
+    //    text
+    std::string m_text;
+    //      
+    kind_type m_kind;
+    int m_current;
+    //      
+    int m_line;
+    std::string m_error;
+
+    bool fail(const std::string &message)
+    {
+        std::ostringstream os;
+        os << "line " << m_line << ": " << message;
+        m_error = os.str();
+        return false;
+    }
+
+    //     
+    int get(std::istream &in)
+    {
+        int c = in.get();
+        if (c == '\n')
+            ++m_line;
+        return c;
+    }
+    static
+    bool is_space(int c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+    //     
+    static
+    std::string trim(const std::string &str)
+    {
+        size_t first = str.find_first_not_of(" \t\r\n");
+        if (first == std::string::npos)
+            return std::string();
+        size_t last = str.find_last_not_of(" \t\r\n");
+        return str.substr(first, last - first + 1);
+    }
+    //    (   )
+    static
+    std::string local(const std::string &name)
+    {
+        size_t colon = name.find(':');
+        return colon == std::string::npos ? name : name.substr(colon + 1);
+    }
+    //   
+    static
+    bool to_int(const std::string &str, int &value)
+    {
+        std::string s = trim(str);
+        if (s.empty() || s.size() > 9 ||
+            s.find_first_not_of("0123456789") != std::string::npos)
+            return false;
+        value = atoi(s.c_str());
+        return true;
+    }
+
+    //      
+    bool skip(std::istream &in, const std::string &pattern, std::string *text)
+    {
+        std::string tail;
+        int c;
+        while ((c = get(in)) != EOF)
+        {
+            tail += char(c);
+            if (tail.size() >= pattern.size() &&
+                tail.compare(tail.size() - pattern.size(),
+                    pattern.size(), pattern) == 0)
+            {
+                if (text)
+                    text->append(tail, 0, tail.size() - pattern.size());
+                return true;
+            };
+            //   ,    
+            if (!text && tail.size() > pattern.size())
+                tail.erase(0, tail.size() - pattern.size());
+        };
+        return fail("unterminated " + pattern);
+    }
+    //      '&'
+    bool entity(std::istream &in, std::string &text)
+    {
+        std::string name;
+        int c;
+        while ((c = get(in)) != EOF && c != ';' && name.size() < 10)
+            name += char(c);
+        if (c != ';')
+            return fail("bad entity");
+        if (name == "lt") text += '<';
+        else if (name == "gt") text += '>';
+        else if (name == "amp") text += '&';
+        else if (name == "quot") text += '"';
+        else if (name == "apos") text += '\'';
+        else if (name.size() > 1 && name[0] == '#')
+        {
+            unsigned long code = name[1] == 'x' ?
+                strtoul(name.c_str() + 2, 0, 16) :
+                strtoul(name.c_str() + 1, 0, 10);
+            //   UTF-8
+            if (code < 0x80)
+                text += char(code);
+            else if (code < 0x800)
+            {
+                text += char(0xC0 | (code >> 6));
+                text += char(0x80 | (code & 0x3F));
+            }
+            else if (code < 0x10000)
+            {
+                text += char(0xE0 | (code >> 12));
+                text += char(0x80 | ((code >> 6) & 0x3F));
+                text += char(0x80 | (code & 0x3F));
+            }
+            else
+            {
+                text += char(0xF0 | (code >> 18));
+                text += char(0x80 | ((code >> 12) & 0x3F));
+                text += char(0x80 | ((code >> 6) & 0x3F));
+                text += char(0x80 | (code & 0x3F));
+            };
+        }
+        else
+            return fail("unknown entity &" + name + ";");
+        return true;
+    }
+
+    // -------   -------
+
+    bool start_element(const std::string &name, attrlist_type &attrs)
+    {
+        m_stack.push_back(name);
+        m_text.clear();
+        if (name == "place" || name == "transition")
+        {
+            const std::string &id = attrs["id"];
+            if (id.empty())
+                return fail(name + " without id");
+            if (m_nodes.count(id) || m_refs.count(id))
+                return fail("duplicate id " + id);
+            node_type node;
+            if (name == "place")
+            {
+                node.kind = kind_place;
+                node.index = m_plnames.size();
+                m_plnames.push_back(id);
+                m_marking.push_back(0);
+            }
+            else
+            {
+                node.kind = kind_transition;
+                node.index = m_trnames.size();
+                m_trnames.push_back(id);
+            };
+            m_nodes[id] = node;
+            m_kind = node.kind;
+            m_current = node.index;
+        }
+        else if (name == "arc")
+        {
+            arcref_type arc = { attrs["source"], attrs["target"], 1 };
+            m_arcrefs.push_back(arc);
+            m_kind = kind_arc;
+            m_current = m_arcrefs.size() - 1;
+        }
+        else if (name == "referencePlace" || name == "referenceTransition")
+        {
+            const std::string &id = attrs["id"];
+            if (id.empty() || m_nodes.count(id) || m_refs.count(id))
+                return fail("bad or duplicate reference id " + id);
+            m_refs[id] = attrs["ref"];
+        };
+        return true;
+    }
+
+    bool end_element(const std::string &name)
+    {
+        if (m_stack.empty() || m_stack.back() != name)
+            return fail("mismatched </" + name + ">");
+        size_t depth = m_stack.size();
+        if (name == "text" && depth >= 3)
+        {
+            const std::string &parent = m_stack[depth - 2];
+            const std::string &owner = m_stack[depth - 3];
+            if (parent == "name" && owner == "place" && m_kind == kind_place)
+                m_plnames[m_current] = trim(m_text);
+            else if (parent == "name" && owner == "transition" &&
+                m_kind == kind_transition)
+                m_trnames[m_current] = trim(m_text);
+            else if (parent == "initialMarking" && owner == "place" &&
+                m_kind == kind_place)
+            {
+                if (!to_int(m_text, m_marking[m_current]))
+                    return fail("bad initial marking");
+            }
+            else if (parent == "inscription" && owner == "arc" &&
+                m_kind == kind_arc)
+            {
+                int &weight = m_arcrefs[m_current].weight;
+                if (!to_int(m_text, weight) || weight <= 0)
+                    return fail("bad arc inscription");
+            };
+        };
+        if (name == "place" || name == "transition" || name == "arc")
+            m_kind = kind_none;
+        m_stack.pop_back();
+        m_text.clear();
+        return true;
+    }
+
+    //    '<'
+    bool markup(std::istream &in)
+    {
+        int c = get(in);
+        //  
+        if (c == '?')
+            return skip(in, "?>", 0);
+        // ,  CDATA  
+        if (c == '!')
+        {
+            std::string head;
+            while (head.size() < 7 && (c = get(in)) != EOF)
+            {
+                head += char(c);
+                if (head == "--")
+                    return skip(in, "-->", 0);
+                if (head == "[CDATA[")
+                    return skip(in, "]]>",
+                        m_stack.empty() || m_stack.back() != "text" ?
+                            0 : &m_text);
+            };
+            //  (,   )
+            int depth = 0;
+            for (size_t k = 0; k < head.size(); ++k)
+                depth += (head[k] == '[') - (head[k] == ']');
+            if (head.find('>') != std::string::npos && depth <= 0)
+                return true;
+            while ((c = get(in)) != EOF)
+            {
+                if (c == '[')
+                    ++depth;
+                else if (c == ']')
+                    --depth;
+                else if (c == '>' && depth <= 0)
+                    return true;
+            };
+            return fail("unterminated declaration");
+        };
+
+        //  
+        bool closing = (c == '/');
+        if (closing)
+            c = get(in);
+        std::string name;
+        while (c != EOF && !is_space(c) && c != '/' && c != '>')
+        {
+            name += char(c);
+            c = get(in);
+        };
+        if (name.empty())
+            return fail("bad markup");
+        name = local(name);
+        if (closing)
+        {
+            while (is_space(c))
+                c = get(in);
+            if (c != '>')
+                return fail("bad closing tag");
+            return end_element(name);
+        };
+
+        // 
+        attrlist_type attrs;
+        for (;;)
+        {
+            while (is_space(c))
+                c = get(in);
+            if (c == '>')
+                return start_element(name, attrs);
+            if (c == '/')
+            {
+                if (get(in) != '>')
+                    return fail("bad empty element");
+                return start_element(name, attrs) && end_element(name);
+            };
+            std::string attr;
+            while (c != EOF && c != '=' && !is_space(c) && c != '>')
+            {
+                attr += char(c);
+                c = get(in);
+            };
+            while (is_space(c))
+                c = get(in);
+            if (c != '=')
+                return fail("bad attribute " + attr);
+            c = get(in);
+            while (is_space(c))
+                c = get(in);
+            if (c != '"' && c != '\'')
+                return fail("bad attribute " + attr);
+            int quote = c;
+            std::string value;
+            while ((c = get(in)) != EOF && c != quote)
+            {
+                if (c == '&')
+                {
+                    if (!entity(in, value))
+                        return false;
+                }
+                else
+                    value += char(c);
+            };
+            if (c == EOF)
+                return fail("unterminated attribute " + attr);
+            attrs[local(attr)] = value;
+            c = get(in);
+        };
+    }
+
+    //        
+    const node_type *find(std::string id) const
+    {
+        for (size_t k = 0; k <= m_refs.size(); ++k)
+        {
+            std::map<std::string, node_type>::const_iterator nt =
+                m_nodes.find(id);
+            if (nt != m_nodes.end())
+                return &nt->second;
+            std::map<std::string, std::string>::const_iterator rt =
+                m_refs.find(id);
+            if (rt == m_refs.end())
+                return 0;
+            id = rt->second;
+        };
+        //  
+        return 0;
+    }
+
+    //   
+    bool resolve(void)
+    {
+        for (size_t k = 0; k < m_arcrefs.size(); ++k)
+        {
+            const arcref_type &ref = m_arcrefs[k];
+            const node_type *source = find(ref.source);
+            const node_type *target = find(ref.target);
+            if (!source || !target)
+                return fail("arc between unknown nodes " +
+                    ref.source + " and " + ref.target);
+            if (source->kind == target->kind)
+                return fail("arc " + ref.source + " -> " + ref.target +
+                    " does not connect a place and a transition");
+            if (source->kind == kind_place)
+            {
+                arc_type arc = { source->index, target->index, ref.weight };
+                m_inarcs.push_back(arc);
+            }
+            else
+            {
+                arc_type arc = { target->index, source->index, ref.weight };
+                m_outarcs.push_back(arc);
+            };
+        };
+        m_arcrefs.clear();
+        return true;
+    }
+
+public:
+    pnml_reader_type(): m_kind(kind_none), m_current(-1), m_line(1) {}
+
+    //   
+    void clear(void)
+    {
+        m_nodes.clear();
+        m_refs.clear();
+        m_plnames.clear();
+        m_trnames.clear();
+        m_marking.clear();
+        m_arcrefs.clear();
+        m_inarcs.clear();
+        m_outarcs.clear();
+        m_stack.clear();
+        m_text.clear();
+        m_kind = kind_none;
+        m_current = -1;
+        m_line = 1;
+        m_error.clear();
+    }
+
+    //  ;    false,
+    //    error()
+    bool read(std::istream &in)
+    {
+        clear();
+        int c;
+        while ((c = get(in)) != EOF)
+        {
+            if (c == '<')
+            {
+                if (!markup(in))
+                    return false;
+            }
+            else if (m_stack.empty() || m_stack.back() != "text")
+                continue;
+            else if (c == '&')
+            {
+                if (!entity(in, m_text))
+                    return false;
+            }
+            else
+                m_text += char(c);
+        };
+        if (!m_stack.empty())
+            return fail("unexpected end of document");
+        return resolve();
+    }
+    bool read(const char *filename)
+    {
+        std::ifstream in(filename, std::ios::binary);
+        if (!in)
+        {
+            m_error = std::string("cannot open ") + filename;
+            return false;
+        };
+        return read(in);
+    }
+    const std::string &error(void) const
+    {
+        return m_error;
+    }
+
+    int places(void) const
+    {
+        return m_plnames.size();
+    }
+    int transitions(void) const
+    {
+        return m_trnames.size();
+    }
+
+    //       (  -
+    //   name,    - )
+    bool save(const char *filename) const
+    {
+        std::vector<place_type> places(m_plnames.size());
+        std::vector<transition_simple_type> transitions(m_trnames.size());
+        transition_compound_type::content_type content;
+        snapshot_type::namelist_type names;
+        for (size_t j = 0; j < places.size(); ++j)
+        {
+            content.add_place(places[j]);
+            if (m_marking[j] > 0)
+                content.add_token(places[j], m_marking[j]);
+            names[&places[j]] = m_plnames[j];
+        };
+        for (size_t i = 0; i < transitions.size(); ++i)
+        {
+            content.add_transition(transitions[i]);
+            names[&transitions[i]] = m_trnames[i];
+        };
+        std::vector<arc_type>::const_iterator it;
+        for (it = m_inarcs.begin(); it != m_inarcs.end(); ++it)
+            content.add_arc(places[it->pl], transitions[it->tr], it->weight);
+        for (it = m_outarcs.begin(); it != m_outarcs.end(); ++it)
+            content.add_arc(transitions[it->tr], places[it->pl], it->weight);
+        return snapshot_type::save(
+            filename, transition_compound_type(content), names);
+    }
+};
+
+} // namespace petri
+} // namespace z
+
+#endif /* _ZPETRI_PNML_HXX_ */
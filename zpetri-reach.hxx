@@ -0,0 +1,835 @@
+/* ------------------------------------------------------------------------- */
+/*        ,                  */
+/*     :                              */
+/*   ..                                                             */
+/*    . - .: -, 2012. - 384 . */
+/*  ISBN 978-5-91359-102-9                                                   */
+/*                                                                           */
+/*     ,           */
+/*                   */
+/*   ,      .  */
+/*                   */
+/*  ,                 */
+/*       .                                     */
+/*     " ",            */
+/*         .       */
+/*                                                                           */
+/*  Copyright  2008-2011  ..                                       */
+/* ------------------------------------------------------------------------- */
+
+
+#ifndef _ZPETRI_REACH_HXX_
+#define _ZPETRI_REACH_HXX_
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <climits>
+#include <cassert>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include "zpetri.hxx"
+#include "zpetri-flat.hxx"
+
+namespace z {
+namespace petri {
+
+//      
+// (     )
+//  -       
+// ;      ( 
+// )   -,   
+//        ; 
+//       
+//     
+//
+//   :    
+//    ( ,   )   
+//            
+// ,       ,  
+//   -    ;  
+//       ( 
+//   ,   ),  
+//        
+//  
+class reachability_type
+{
+public:
+    typedef transition_abstract_type::markedlist_type markedlist_type;
+
+    //   
+    enum boundedness_type
+    {
+        //   ,  bounds -  
+        bounded,
+        //   :   unbounded 
+        unbounded,
+        //      ,  
+        // , - bounds   
+        unknown
+    };
+
+    //  
+    struct report_type
+    {
+        //    
+        long long states;
+        //     
+        long long edges;
+        //    (  )
+        long long deadlocks;
+        //     
+        markedlist_type deadlock;
+        //      
+        //   
+        markedlist_type bounds;
+        //    (  
+        //    )
+        bool complete;
+        //  
+        boundedness_type boundedness;
+        // ,    
+        // (    )
+        std::vector<place_type *> unbounded;
+        //    
+        double seconds;
+
+        //  
+        double states_per_second(void) const
+        {
+            return seconds > 0 ? states / seconds : 0;
+        }
+    };
+
+private:
+    typedef std::vector<int> marking_type;
+    typedef std::vector<char> activity_type;
+    typedef std::vector<unsigned char> buffer_type;
+
+    // -------    -------
+
+    //      ( 7   )
+    static
+    void put_varint(buffer_type &buf, unsigned value)
+    {
+        while (value >= 0x80)
+        {
+            buf.push_back((unsigned char)(value | 0x80));
+            value >>= 7;
+        };
+        buf.push_back((unsigned char)value);
+    }
+    //     
+    static
+    unsigned get_varint(const unsigned char *&p)
+    {
+        unsigned value = 0;
+        for (int shift = 0; ; shift += 7)
+        {
+            unsigned char c = *p++;
+            value |= unsigned(c & 0x7f) << shift;
+            if (!(c & 0x80))
+                break;
+        };
+        return value;
+    }
+    //    (FNV-1a)
+    static
+    unsigned long long hash(const unsigned char *p, size_t len)
+    {
+        unsigned long long h = 14695981039346656037ULL;
+        for (size_t i = 0; i < len; ++i)
+            h = (h ^ p[i]) * 1099511628211ULL;
+        return h;
+    }
+
+    //    ,   : -
+    // (0  )       
+    //         
+    // (      )
+    struct link_type
+    {
+        const unsigned char *parent;
+        long long minsum;
+    };
+    static
+    link_type get_link(const unsigned char *p)
+    {
+        link_type link;
+        std::memcpy(&link, p - sizeof(link_type), sizeof(link_type));
+        return link;
+    }
+
+    //  -    
+    //   (,   ) 
+    //  ,   ,    
+    // 
+    struct shard_type
+    {
+        std::mutex mutex;
+        //  ,   -  
+        std::vector<const unsigned char *> table;
+        size_t count;
+        //     (  )
+        //      4   1 ,  
+        //        
+        std::deque<std::unique_ptr<unsigned char[]> > blocks;
+        size_t capacity, used;
+
+        shard_type():
+            table(64, (const unsigned char *)0), count(0), capacity(0), used(0)
+        {}
+
+        //        
+        const unsigned char *store(const buffer_type &buf, const link_type &link)
+        {
+            size_t size = sizeof(link_type) + buf.size();
+            if (used + size > capacity)
+            {
+                capacity = std::max(blocks.empty() ? size_t(4096) :
+                    std::min(capacity * 2, size_t(1) << 20), size);
+                blocks.push_back(std::unique_ptr<unsigned char[]>(
+                    new unsigned char[capacity]));
+                used = 0;
+            };
+            unsigned char *p = blocks.back().get() + used;
+            std::memcpy(p, &link, sizeof(link_type));
+            std::memcpy(p + sizeof(link_type), &buf[0], buf.size());
+            used += size;
+            return p + sizeof(link_type);
+        }
+        //      
+        static
+        size_t length(const unsigned char *p)
+        {
+            const unsigned char *q = p;
+            size_t len = get_varint(q);
+            return (q - p) + len;
+        }
+        //    
+        size_t probe(const unsigned char *p, size_t len, size_t h) const
+        {
+            size_t mask = table.size() - 1;
+            size_t i = h & mask;
+            while (table[i] &&
+                !(length(table[i]) == len && !std::memcmp(table[i], p, len)))
+                i = (i + 1) & mask;
+            return i;
+        }
+        //  ,    
+        //       0
+        const unsigned char *insert(
+            const buffer_type &buf, size_t h, const link_type &link)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            size_t i = probe(&buf[0], buf.size(), h);
+            if (table[i])
+                return 0;
+            const unsigned char *p = store(buf, link);
+            table[i] = p;
+            //       
+            if (++count * 2 > table.size())
+            {
+                std::vector<const unsigned char *> old(
+                    table.size() * 2, (const unsigned char *)0);
+                old.swap(table);
+                for (size_t k = 0; k < old.size(); ++k)
+                {
+                    if (old[k])
+                    {
+                        size_t len = length(old[k]);
+                        table[probe(old[k], len, hash(old[k], len))] = old[k];
+                    };
+                };
+            };
+            return p;
+        }
+    };
+
+    // -------    -------
+
+    //  ,  
+    //     ,   -  
+    struct workqueue_type
+    {
+        std::mutex mutex;
+        std::deque<const unsigned char *> items;
+    };
+
+    //    
+    struct worker_type
+    {
+        //   
+        marking_type bounds;
+        //      
+        long long edges, deadlocks;
+        //     
+        marking_type deadlock;
+        //  ,   
+        std::vector<int> unbounded;
+        worker_type(): edges(0), deadlocks(0) {}
+    };
+
+    //      
+    // (      )
+    struct undo_type
+    {
+        std::vector<std::pair<int, int> > marking;
+        std::vector<std::pair<int, char> > active;
+    };
+
+    //  
+    flatnet_type m_net;
+    //      (  )
+    int m_top;
+    //   
+    std::vector<int> m_compounds;
+    //     
+    // (   -   )
+    std::vector<int> m_sources;
+
+    //   
+    std::deque<shard_type> m_shards;
+    std::deque<workqueue_type> m_queues;
+    //       
+    std::atomic<long long> m_pending;
+    //   
+    std::atomic<long long> m_states;
+    //     (0 -  )
+    long long m_maxstates;
+    //    ( )
+    std::atomic<bool> m_unbounded;
+
+    // -------     -------
+
+    //     
+    bool is_live(const activity_type &active, int t) const
+    {
+        int owner = m_net.m_netowner[m_net.m_trnet[t]];
+        return owner < 0 || active[owner];
+    }
+    //    (   )
+    bool is_enabled(
+        const marking_type &marking, const activity_type &active, int t) const
+    {
+        if (active[t])
+            return false;
+        const flatnet_type::arcmatrix_type &in = m_net.m_mtxin;
+        for (int k = in.start[t]; k < in.start[t + 1]; ++k)
+            if (marking[in.index[k]] < in.weight[k])
+                return false;
+        return true;
+    }
+    //      ,  
+    bool net_active(
+        const marking_type &marking, const activity_type &active, int net) const
+    {
+        const flatnet_type::arcmatrix_type &tr = m_net.m_nettrans;
+        for (int k = tr.start[net]; k < tr.start[net + 1]; ++k)
+        {
+            int t = tr.index[k];
+            if (active[t] || is_enabled(marking, active, t))
+                return true;
+        };
+        return false;
+    }
+    //      
+    //    
+    static
+    void set_marking(marking_type &marking, undo_type &undo, int j, int value)
+    {
+        if (marking[j] == value)
+            return;
+        undo.marking.push_back(std::make_pair(j, marking[j]));
+        marking[j] = value;
+    }
+    static
+    void set_active(activity_type &active, undo_type &undo, int t, bool value)
+    {
+        if (bool(active[t]) == value)
+            return;
+        undo.active.push_back(std::make_pair(t, active[t]));
+        active[t] = value;
+    }
+    //     
+    static
+    void rollback(marking_type &marking, activity_type &active, undo_type &undo)
+    {
+        while (!undo.marking.empty())
+        {
+            marking[undo.marking.back().first] = undo.marking.back().second;
+            undo.marking.pop_back();
+        };
+        while (!undo.active.empty())
+        {
+            active[undo.active.back().first] = undo.active.back().second;
+            undo.active.pop_back();
+        };
+    }
+
+    //   ( flatnet_type::fire,  
+    //  ;    ,
+    //      )
+    void fire(
+        marking_type &marking, activity_type &active, int t,
+        undo_type &undo) const
+    {
+        const flatnet_type::arcmatrix_type &in = m_net.m_mtxin;
+        const flatnet_type::arcmatrix_type &out = m_net.m_mtxout;
+        for (int k = in.start[t]; k < in.start[t + 1]; ++k)
+            set_marking(marking, undo, in.index[k],
+                marking[in.index[k]] - in.weight[k]);
+        int child = m_net.m_trchild[t];
+        if (child >= 0)
+        {
+            for (int j = m_net.m_netplace[child];
+                j < m_net.m_netplace[child + 1]; ++j)
+                set_marking(marking, undo, j, m_net.m_marking_init[j]);
+            const flatnet_type::arcmatrix_type &tr = m_net.m_nettrans;
+            for (int k = tr.start[child]; k < tr.start[child + 1]; ++k)
+                set_active(active, undo, tr.index[k], false);
+            set_active(active, undo, t, net_active(marking, active, child));
+        };
+        for (int cur = t; !active[cur]; )
+        {
+            child = m_net.m_trchild[cur];
+            if (child >= 0)
+                for (int j = m_net.m_netplace[child];
+                    j < m_net.m_netplace[child + 1]; ++j)
+                    set_marking(marking, undo, j, 0);
+            for (int k = out.start[cur]; k < out.start[cur + 1]; ++k)
+                set_marking(marking, undo, out.index[k],
+                    marking[out.index[k]] + out.weight[k]);
+            int net = m_net.m_trnet[cur];
+            cur = m_net.m_netowner[net];
+            if (cur < 0 || net_active(marking, active, net))
+                break;
+            set_active(active, undo, cur, false);
+        };
+    }
+
+    //      
+    size_t activity_size(void) const
+    {
+        return (m_compounds.size() + 7) / 8;
+    }
+    //  : ,   ( 
+    //   ),  
+    // places -   ,   
+    //   ( )
+    void encode(
+        const marking_type &marking,
+        const activity_type &active,
+        const std::vector<int> &places,
+        buffer_type &buf,
+        buffer_type &body) const
+    {
+        body.clear();
+        int next = 0;
+        for (size_t k = 0; k < places.size(); ++k)
+        {
+            int j = places[k];
+            assert(marking[j] >= 0);
+            if (marking[j] == 0)
+                continue;
+            put_varint(body, j - next);
+            put_varint(body, marking[j]);
+            next = j + 1;
+        };
+        for (size_t i = 0; i < m_compounds.size(); i += 8)
+        {
+            unsigned char bits = 0;
+            for (size_t b = 0; b < 8 && i + b < m_compounds.size(); ++b)
+                if (active[m_compounds[i + b]])
+                    bits |= 1 << b;
+            body.push_back(bits);
+        };
+        buf.clear();
+        put_varint(buf, body.size());
+        buf.insert(buf.end(), body.begin(), body.end());
+    }
+    //    ,    
+    //   marked (  )
+    void decode(
+        const unsigned char *p,
+        marking_type &marking,
+        activity_type &active,
+        std::vector<int> &marked) const
+    {
+        for (size_t k = 0; k < marked.size(); ++k)
+            marking[marked[k]] = 0;
+        marked.clear();
+        size_t len = get_varint(p);
+        const unsigned char *end = p + len - activity_size();
+        for (int j = 0; p < end; ++j)
+        {
+            j += get_varint(p);
+            marking[j] = get_varint(p);
+            marked.push_back(j);
+        };
+        for (size_t i = 0; i < m_compounds.size(); ++i)
+            active[m_compounds[i]] = (p[i / 8] >> (i % 8)) & 1;
+    }
+
+    // -------   -------
+
+    //       
+    // (places -  ,    )
+    long long top_sum(
+        const marking_type &marking, const std::vector<int> &places) const
+    {
+        long long sum = 0;
+        for (size_t k = 0; k < places.size() && places[k] < m_top; ++k)
+            sum += marking[places[k]];
+        return sum;
+    }
+    //      
+    // (j -    -1; INT_MAX,    )
+    static
+    void next_marked(
+        const unsigned char *&p, const unsigned char *end, int &j, int &value)
+    {
+        if (p < end)
+        {
+            j += 1 + get_varint(p);
+            value = get_varint(p);
+        }
+        else
+            j = INT_MAX;
+    }
+    //    p   q,   
+    //      ; ,  
+    //  ,   grown
+    bool covers(
+        const unsigned char *p,
+        const unsigned char *q,
+        std::vector<int> &grown) const
+    {
+        const unsigned char *pend = p + get_varint(p);
+        const unsigned char *qend = q + get_varint(q);
+        pend -= activity_size();
+        qend -= activity_size();
+        //   
+        if (std::memcmp(pend, qend, activity_size()) != 0)
+            return false;
+        size_t first = grown.size();
+        int pj = -1, qj = -1, pv = 0, qv = 0;
+        next_marked(p, pend, pj, pv);
+        next_marked(q, qend, qj, qv);
+        while (pj != INT_MAX || qj != INT_MAX)
+        {
+            bool ok;
+            if (pj < qj)
+            {
+                //     p
+                ok = pj < m_top;
+                if (ok)
+                    grown.push_back(pj);
+                next_marked(p, pend, pj, pv);
+            }
+            else if (qj < pj)
+                ok = false;
+            else
+            {
+                ok = pv >= qv && (pv == qv || pj < m_top);
+                if (ok && pv > qv)
+                    grown.push_back(pj);
+                next_marked(p, pend, pj, pv);
+                next_marked(q, qend, qj, qv);
+            };
+            if (!ok)
+            {
+                grown.resize(first);
+                return false;
+            };
+        };
+        return grown.size() > first;
+    }
+    //  ,     p
+    //    sum    : 
+    // ,      
+    //     
+    bool covers_ancestor(
+        const unsigned char *p,
+        long long sum,
+        std::vector<int> &grown) const
+    {
+        for (const unsigned char *q = get_link(p).parent; q;
+            q = get_link(q).parent)
+        {
+            if (sum <= get_link(q).minsum)
+                break;
+            if (covers(p, q, grown))
+                return true;
+        };
+        return false;
+    }
+
+    // -------  -------
+
+    //     ,   ,  
+    // (     parent);  
+    //   0,     
+    const unsigned char *submit(
+        const buffer_type &buf,
+        int self,
+        const unsigned char *parent,
+        long long sum)
+    {
+        size_t h = hash(&buf[0], buf.size());
+        link_type link = { parent,
+            parent ? std::min(sum, get_link(parent).minsum) : sum };
+        const unsigned char *p =
+            m_shards[(h >> 48) % m_shards.size()].insert(buf, h, link);
+        if (!p)
+            return 0;
+        //       
+        if (++m_states > m_maxstates && m_maxstates > 0)
+            return p;
+        ++m_pending;
+        workqueue_type &q = m_queues[self];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.items.push_back(p);
+        return p;
+    }
+
+    //        
+    const unsigned char *take(int self)
+    {
+        {
+            workqueue_type &q = m_queues[self];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (!q.items.empty())
+            {
+                const unsigned char *p = q.items.back();
+                q.items.pop_back();
+                return p;
+            };
+        }
+        for (size_t k = 1; k < m_queues.size(); ++k)
+        {
+            workqueue_type &q = m_queues[(self + k) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (!q.items.empty())
+            {
+                const unsigned char *p = q.items.front();
+                q.items.pop_front();
+                return p;
+            };
+        };
+        return 0;
+    }
+
+    //   
+    void explore_thread(int self, worker_type &w)
+    {
+        int plnum = m_net.m_plptr.size(), trnum = m_net.m_trptr.size();
+        const flatnet_type::arcmatrix_type &consumers = m_net.m_consumers;
+        marking_type marking(plnum, 0);
+        activity_type active(trnum, false);
+        //       
+        std::vector<int> marked, places;
+        // -      
+        std::vector<int> candidates;
+        std::vector<unsigned> stamp(trnum, 0);
+        unsigned current = 0;
+        undo_type undo;
+        buffer_type buf, body;
+        w.bounds.assign(plnum, 0);
+
+        while (m_pending > 0)
+        {
+            const unsigned char *p = take(self);
+            if (!p)
+            {
+                std::this_thread::yield();
+                continue;
+            };
+            //      
+            if (m_unbounded)
+            {
+                --m_pending;
+                continue;
+            };
+            decode(p, marking, active, marked);
+            for (size_t k = 0; k < marked.size(); ++k)
+                w.bounds[marked[k]] =
+                    std::max(w.bounds[marked[k]], marking[marked[k]]);
+
+            // :   
+            //     
+            if (++current == 0)
+            {
+                std::fill(stamp.begin(), stamp.end(), 0);
+                current = 1;
+            };
+            candidates.clear();
+            for (size_t m = 0; m < marked.size(); ++m)
+            {
+                for (int k = consumers.start[marked[m]];
+                    k < consumers.start[marked[m] + 1]; ++k)
+                {
+                    int t = consumers.index[k];
+                    if (stamp[t] != current)
+                    {
+                        stamp[t] = current;
+                        candidates.push_back(t);
+                    };
+                };
+            };
+            candidates.insert(candidates.end(),
+                m_sources.begin(), m_sources.end());
+
+            bool any = false;
+            for (size_t c = 0; c < candidates.size(); ++c)
+            {
+                int t = candidates[c];
+                if (!is_live(active, t) || !is_enabled(marking, active, t))
+                    continue;
+                any = true;
+                //      
+                fire(marking, active, t, undo);
+                places.clear();
+                for (size_t k = 0; k < undo.marking.size(); ++k)
+                    places.push_back(undo.marking[k].first);
+                std::sort(places.begin(), places.end());
+                size_t changed = places.size();
+                places.insert(places.end(), marked.begin(), marked.end());
+                std::inplace_merge(places.begin(),
+                    places.begin() + changed, places.end());
+                places.erase(std::unique(places.begin(), places.end()),
+                    places.end());
+                encode(marking, active, places, buf, body);
+                long long sum = top_sum(marking, places);
+                rollback(marking, active, undo);
+                ++w.edges;
+                const unsigned char *q = submit(buf, self, p, sum);
+                if (q && covers_ancestor(q, sum, w.unbounded))
+                    m_unbounded = true;
+            };
+            if (!any && w.deadlocks++ == 0)
+                w.deadlock = marking;
+            --m_pending;
+        };
+    }
+
+    //      
+    markedlist_type to_marked(const marking_type &marking) const
+    {
+        markedlist_type marked;
+        for (size_t j = 0; j < marking.size(); ++j)
+            if (marking[j] > 0)
+                marked[m_net.m_plptr[j]] = marking[j];
+        return marked;
+    }
+
+public:
+    //        
+    explicit
+    reachability_type(const transition_compound_type &root):
+        m_net(root), m_top(m_net.m_netplace[1]),
+        m_pending(0), m_states(0), m_maxstates(0), m_unbounded(false)
+    {
+        for (size_t t = 0; t < m_net.m_trchild.size(); ++t)
+        {
+            if (m_net.m_trchild[t] >= 0)
+                m_compounds.push_back(t);
+            if (m_net.m_mtxin.start[t] == m_net.m_mtxin.start[t + 1])
+                m_sources.push_back(t);
+        };
+    }
+
+    //      
+    // (  -    )  
+    //    (0 -  );  
+    //    ,   
+    //    (.  )
+    report_type explore(int threads = 0, long long maxstates = 0)
+    {
+        if (threads <= 0)
+            threads = std::thread::hardware_concurrency();
+        if (threads <= 0)
+            threads = 1;
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+
+        m_shards.clear();
+        m_shards.resize(threads * 16);
+        m_queues.clear();
+        m_queues.resize(threads);
+        m_pending = 0;
+        m_states = 0;
+        m_maxstates = maxstates;
+        m_unbounded = false;
+
+        //  
+        int plnum = m_net.m_plptr.size();
+        marking_type marking(m_net.m_marking_init.begin(),
+            m_net.m_marking_init.begin() + m_net.m_netplace[1]);
+        marking.resize(plnum, 0);
+        activity_type active(m_net.m_trptr.size(), false);
+        std::vector<int> places;
+        for (int j = 0; j < plnum; ++j)
+            places.push_back(j);
+        buffer_type buf, body;
+        encode(marking, active, places, buf, body);
+        submit(buf, 0, 0, top_sum(marking, places));
+
+        // 
+        std::vector<worker_type> workers(threads);
+        std::vector<std::thread> pool;
+        for (int i = 0; i < threads; ++i)
+            pool.push_back(std::thread(&reachability_type::explore_thread,
+                this, i, std::ref(workers[i])));
+        for (int i = 0; i < threads; ++i)
+            pool[i].join();
+
+        //  
+        report_type report;
+        bool limited = (maxstates > 0 && m_states > maxstates);
+        report.complete = !limited && !m_unbounded;
+        report.states = limited ? maxstates : (long long)m_states;
+        report.boundedness = m_unbounded ? unbounded :
+            (limited ? unknown : bounded);
+        report.edges = 0;
+        report.deadlocks = 0;
+        marking_type bounds(plnum, 0);
+        std::vector<int> unbounded;
+        for (int i = 0; i < threads; ++i)
+        {
+            report.edges += workers[i].edges;
+            if (workers[i].deadlocks > 0 && report.deadlocks == 0)
+                report.deadlock = to_marked(workers[i].deadlock);
+            report.deadlocks += workers[i].deadlocks;
+            for (int j = 0; j < plnum; ++j)
+                bounds[j] = std::max(bounds[j], workers[i].bounds[j]);
+            unbounded.insert(unbounded.end(),
+                workers[i].unbounded.begin(), workers[i].unbounded.end());
+        };
+        std::sort(unbounded.begin(), unbounded.end());
+        unbounded.erase(std::unique(unbounded.begin(), unbounded.end()),
+            unbounded.end());
+        for (size_t k = 0; k < unbounded.size(); ++k)
+            report.unbounded.push_back(m_net.m_plptr[unbounded[k]]);
+        for (int j = 0; j < plnum; ++j)
+            report.bounds[m_net.m_plptr[j]] = bounds[j];
+        report.seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+        //   
+        m_shards.clear();
+        m_queues.clear();
+        return report;
+    }
+};
+
+} // namespace petri
+} // namespace z
+
+#endif /* _ZPETRI_REACH_HXX_ */
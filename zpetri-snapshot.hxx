@@ -0,0 +1,595 @@
+/* ------------------------------------------------------------------------- */
+/*        ,                  */
+/*     :                              */
+/*   ..                                                             */
+/*    . - .: -, 2012. - 384 . */
+/*  ISBN 978-5-91359-102-9                                                   */
+/*                                                                           */
+/*     ,           */
+/*                   */
+/*   ,      .  */
+/*                   */
+/*  ,                 */
+/*       .                                     */
+/*     " ",            */
+/*         .       */
+/*                                                                           */
+/*  Copyright  2008-2011  ..                                       */
+/* ------------------------------------------------------------------------- */
+
+
+#ifndef _ZPETRI_SNAPSHOT_HXX_
+#define _ZPETRI_SNAPSHOT_HXX_
+
+#include <vector>
+#include <map>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "zpetri.hxx"
+
+namespace z {
+namespace petri {
+
+//         ;
+//       ,   
+//    (, , ):  
+//         ,  
+// ,         ;
+//     ,      
+//
+//   (32-      ,
+// T -  , P - , in  out -   
+//    ):
+//    header_type;
+//     : start[T + 1], index[in], weight[in];
+//     : start[T + 1], index[out], weight[out];
+//    : start[P + 1], index[in], weight[in];
+//    : marking[P];
+//    : offset[P + T + 1] ( ,  );
+//   ,   : namebytes 
+//
+//   -      
+//    ,      ;
+//      ,  
+//        -   
+// (   ) :   
+//      ,    
+// checkpoint 
+class snapshot_type
+{
+public:
+    //      
+    typedef std::map<const void *, std::string> namelist_type;
+    //  
+    static const uint32_t version = 1;
+
+private:
+    typedef transition_compound_type::image_type image_type;
+
+    //   
+    struct header_type
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteorder;
+        uint32_t places, transitions;
+        uint32_t inarcs, outarcs;
+        uint32_t namebytes;
+        uint32_t reserved;
+    };
+    //    
+    struct checkheader_type
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteorder;
+        uint32_t places;
+        uint32_t reserved;
+        uint64_t fingerprint;
+    };
+
+    //     int  
+    static_assert(sizeof(int) == sizeof(uint32_t), "32-bit int required");
+
+    //    
+    const char *m_data;
+    size_t m_size;
+#ifdef _WIN32
+    HANDLE m_mapping;
+#endif
+    //      
+    std::vector<place_type> m_places;
+    std::vector<transition_simple_type> m_transitions;
+    std::vector<place_type *> m_plptr;
+    std::vector<transition_abstract_type *> m_trptr;
+    //  ,     
+    image_type m_image;
+    //    
+    const uint32_t *m_nameoffset;
+    const char *m_names;
+
+    //   
+    snapshot_type(const snapshot_type &);
+    snapshot_type &operator =(const snapshot_type &);
+
+    static
+    uint32_t byteorder(void)
+    {
+        return 0x01020304;
+    }
+
+    //    
+    template <class T>
+    static
+    bool put(FILE *file, const T *data, size_t size)
+    {
+        return size == 0 || fwrite(data, sizeof(T), size, file) == size;
+    }
+    template <class T>
+    static
+    bool put(FILE *file, const std::vector<T> &v)
+    {
+        return v.empty() || put(file, &v[0], v.size());
+    }
+    //   CSR    
+    static
+    bool put(
+        FILE *file,
+        int rows,
+        const int *start,
+        const int *index,
+        const int *weight)
+    {
+        return put(file, start, rows + 1) &&
+            put(file, index, start[rows]) && put(file, weight, start[rows]);
+    }
+
+    //      
+    static
+    bool replace(const std::string &from, const char *to)
+    {
+#ifdef _WIN32
+        return MoveFileExA(from.c_str(), to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        return std::rename(from.c_str(), to) == 0;
+#endif
+    }
+
+    //    
+    bool map(const char *filename)
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ,
+            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+            m_mapping = CreateFileMappingA(
+                file, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(file);
+        if (!m_mapping)
+            return false;
+        m_data = (const char *)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!m_data)
+        {
+            CloseHandle(m_mapping);
+            m_mapping = NULL;
+            return false;
+        };
+        m_size = size_t(size.QuadPart);
+#else
+        int fd = ::open(filename, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        void *data = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+            data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED)
+            return false;
+        m_data = (const char *)data;
+        m_size = st.st_size;
+#endif
+        return true;
+    }
+    void unmap(void)
+    {
+        if (!m_data)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+        m_mapping = NULL;
+#else
+        munmap((void *)m_data, m_size);
+#endif
+        m_data = 0;
+        m_size = 0;
+    }
+
+    //   :  ,  
+    // (    , ..   )
+    //   
+    static
+    bool valid_matrix(
+        const int *start, const int *index, const int *weight,
+        uint64_t rows, uint64_t cols, uint64_t arcs)
+    {
+        if (start[0] != 0 || uint64_t(start[rows]) != arcs)
+            return false;
+        for (uint64_t i = 0; i < rows; ++i)
+            if (start[i] > start[i + 1])
+                return false;
+        for (uint64_t k = 0; k < arcs; ++k)
+            if (index[k] < 0 || uint64_t(index[k]) >= cols || weight[k] <= 0)
+                return false;
+        for (uint64_t i = 0; i < rows; ++i)
+            for (int k = start[i] + 1; k < start[i + 1]; ++k)
+                if (index[k] <= index[k - 1])
+                    return false;
+        return true;
+    }
+
+    //  ,    tr - 
+    //    m:     m  
+    //    tr ( m   , 
+    //     tr    )
+    static
+    bool valid_transpose(
+        const int *start, const int *index, const int *weight, uint64_t rows,
+        const int *trstart, const int *trindex, const int *trweight,
+        uint64_t cols)
+    {
+        std::vector<int> cursor(trstart, trstart + cols);
+        for (uint64_t i = 0; i < rows; ++i)
+        {
+            for (int k = start[i]; k < start[i + 1]; ++k)
+            {
+                int j = index[k];
+                int pos = cursor[j]++;
+                if (pos >= trstart[j + 1] || uint64_t(trindex[pos]) != i ||
+                    trweight[pos] != weight[k])
+                    return false;
+            };
+        };
+        return true;
+    }
+
+    //  ,     
+    //  ,    :     
+    //         , 
+    //  -    ,  - 
+    // ,   -    
+    bool validate(void) const
+    {
+        if (m_size < sizeof(header_type))
+            return false;
+        const header_type &h = *(const header_type *)m_data;
+        if (memcmp(h.magic, "ZPETRINT", 8) != 0 ||
+            h.version != version || h.byteorder != byteorder())
+            return false;
+        uint64_t p = h.places, t = h.transitions;
+        uint64_t in = h.inarcs, out = h.outarcs;
+        if (p > 0x7fffffff || t > 0x7fffffff || in > 0x7fffffff ||
+            out > 0x7fffffff)
+            return false;
+        uint64_t ints = 2 * (t + 1) + (p + 1) + 4 * in + 2 * out + p +
+            (p + t + 1);
+        if (m_size != sizeof(header_type) + 4 * ints + h.namebytes)
+            return false;
+
+        const int *instart = (const int *)(m_data + sizeof(header_type));
+        const int *outstart = instart + (t + 1) + 2 * in;
+        const int *consstart = outstart + (t + 1) + 2 * out;
+        const int *marking = consstart + (p + 1) + 2 * in;
+        if (!valid_matrix(instart, instart + t + 1, instart + t + 1 + in,
+                t, p, in) ||
+            !valid_matrix(outstart, outstart + t + 1, outstart + t + 1 + out,
+                t, p, out) ||
+            !valid_matrix(consstart, consstart + p + 1,
+                consstart + p + 1 + in, p, t, in) ||
+            !valid_transpose(instart, instart + t + 1, instart + t + 1 + in,
+                t, consstart, consstart + p + 1, consstart + p + 1 + in, p))
+            return false;
+        for (uint64_t j = 0; j < p; ++j)
+            if (marking[j] < 0)
+                return false;
+
+        //        
+        const uint32_t *offset = (const uint32_t *)(marking + p);
+        const char *names = (const char *)(offset + p + t + 1);
+        if (offset[0] != 0 || offset[p + t] != h.namebytes)
+            return false;
+        for (uint64_t k = 0; k < p + t; ++k)
+            if (offset[k] >= offset[k + 1] || offset[k + 1] > h.namebytes ||
+                names[offset[k + 1] - 1] != '\0')
+                return false;
+        return true;
+    }
+
+    //    (FNV-1a    )
+    static
+    void fingerprint(uint64_t &hash, int value)
+    {
+        hash ^= uint32_t(value);
+        hash *= 1099511628211ULL;
+    }
+    static
+    void fingerprint(uint64_t &hash, const int *v, int size)
+    {
+        for (int k = 0; k < size; ++k)
+            fingerprint(hash, v[k]);
+    }
+    static
+    uint64_t fingerprint(const transition_compound_type &net)
+    {
+        const image_type &a = net.net();
+        int t = a.transitions;
+        uint64_t hash = 14695981039346656037ULL;
+        fingerprint(hash, a.places);
+        fingerprint(hash, t);
+        fingerprint(hash, a.instart, t + 1);
+        fingerprint(hash, a.inindex, a.instart[t]);
+        fingerprint(hash, a.inweight, a.instart[t]);
+        fingerprint(hash, a.outstart, t + 1);
+        fingerprint(hash, a.outindex, a.outstart[t]);
+        fingerprint(hash, a.outweight, a.outstart[t]);
+        return hash;
+    }
+
+public:
+    snapshot_type(): m_data(0), m_size(0), m_nameoffset(0), m_names(0)
+    {
+#ifdef _WIN32
+        m_mapping = NULL;
+#endif
+        memset(&m_image, 0, sizeof(m_image));
+    }
+    ~snapshot_type()
+    {
+        close();
+    }
+
+    // -------     -------
+
+    //       
+    // (     )
+    static
+    bool save(
+        const char *filename,
+        const transition_compound_type &net,
+        const namelist_type &names = namelist_type())
+    {
+        //   (   )  
+        const image_type &a = net.net();
+        int p = a.places, t = a.transitions;
+        for (int i = 0; i < t; ++i)
+            if (dynamic_cast<const transition_compound_type *>(a.trlist[i]))
+                return false;
+
+        //  :  ,  
+        std::vector<const void *> objects(a.pllist, a.pllist + p);
+        objects.insert(objects.end(), a.trlist, a.trlist + t);
+        std::vector<uint32_t> offset;
+        std::vector<char> text;
+        for (size_t k = 0; k < objects.size(); ++k)
+        {
+            offset.push_back(text.size());
+            namelist_type::const_iterator it = names.find(objects[k]);
+            if (it != names.end())
+                text.insert(text.end(), it->second.begin(), it->second.end());
+            text.push_back('\0');
+        };
+        offset.push_back(text.size());
+
+        header_type h;
+        memcpy(h.magic, "ZPETRINT", 8);
+        h.version = version;
+        h.byteorder = byteorder();
+        h.places = p;
+        h.transitions = t;
+        h.inarcs = a.instart[t];
+        h.outarcs = a.outstart[t];
+        h.namebytes = text.size();
+        h.reserved = 0;
+
+        FILE *file = fopen(filename, "wb");
+        if (!file)
+            return false;
+        bool ok = fwrite(&h, sizeof(h), 1, file) == 1 &&
+            put(file, t, a.instart, a.inindex, a.inweight) &&
+            put(file, t, a.outstart, a.outindex, a.outweight) &&
+            put(file, p, a.consstart, a.consindex, a.consweight) &&
+            put(file, a.marking, p) &&
+            put(file, offset) && put(file, text);
+        return fclose(file) == 0 && ok;
+    }
+
+    //  :      
+    //    
+    bool open(const char *filename)
+    {
+        close();
+        if (!map(filename))
+            return false;
+        if (!validate())
+        {
+            close();
+            return false;
+        };
+        const header_type &h = *(const header_type *)m_data;
+        int p = h.places, t = h.transitions;
+
+        m_places.resize(p);
+        m_transitions.resize(t);
+        m_plptr.resize(p);
+        m_trptr.resize(t);
+        for (int j = 0; j < p; ++j)
+            m_plptr[j] = &m_places[j];
+        for (int i = 0; i < t; ++i)
+            m_trptr[i] = &m_transitions[i];
+
+        //        
+        const int *body = (const int *)(m_data + sizeof(header_type));
+        m_image.places = p;
+        m_image.transitions = t;
+        m_image.pllist = p ? &m_plptr[0] : 0;
+        m_image.trlist = t ? &m_trptr[0] : 0;
+        m_image.instart = body;
+        m_image.inindex = m_image.instart + t + 1;
+        m_image.inweight = m_image.inindex + h.inarcs;
+        m_image.outstart = m_image.inweight + h.inarcs;
+        m_image.outindex = m_image.outstart + t + 1;
+        m_image.outweight = m_image.outindex + h.outarcs;
+        m_image.consstart = m_image.outweight + h.outarcs;
+        m_image.consindex = m_image.consstart + p + 1;
+        m_image.consweight = m_image.consindex + h.inarcs;
+        m_image.marking = m_image.consweight + h.inarcs;
+        m_nameoffset = (const uint32_t *)(m_image.marking + p);
+        m_names = (const char *)(m_nameoffset + p + t + 1);
+        return true;
+    }
+    //   (     
+    //   -     )
+    void close(void)
+    {
+        unmap();
+        m_places.clear();
+        m_transitions.clear();
+        m_plptr.clear();
+        m_trptr.clear();
+        memset(&m_image, 0, sizeof(m_image));
+        m_nameoffset = 0;
+        m_names = 0;
+    }
+    bool is_open(void) const
+    {
+        return m_data != 0;
+    }
+
+    //     transition_compound_type
+    //  petrinet_type
+    const image_type &image(void) const
+    {
+        return m_image;
+    }
+
+    // -------      -------
+
+    int places(void) const
+    {
+        return m_image.places;
+    }
+    int transitions(void) const
+    {
+        return m_image.transitions;
+    }
+    place_type *place(int j) const
+    {
+        return m_plptr[j];
+    }
+    transition_abstract_type *transition(int i) const
+    {
+        return m_trptr[i];
+    }
+    const char *place_name(int j) const
+    {
+        return m_names + m_nameoffset[j];
+    }
+    const char *transition_name(int i) const
+    {
+        return m_names + m_nameoffset[m_image.places + i];
+    }
+    //    (0,   )
+    place_type *find_place(const char *name) const
+    {
+        for (int j = 0; j < places(); ++j)
+            if (strcmp(place_name(j), name) == 0)
+                return place(j);
+        return 0;
+    }
+    transition_abstract_type *find_transition(const char *name) const
+    {
+        for (int i = 0; i < transitions(); ++i)
+            if (strcmp(transition_name(i), name) == 0)
+                return transition(i);
+        return 0;
+    }
+
+    // -------   -------
+
+    //      
+    //       (   
+    //   ,  false);  
+    //    
+    static
+    bool checkpoint(const char *filename, const transition_compound_type &net)
+    {
+        //    
+        if (int(net.m_marking.size()) != net.pl_num() ||
+            !net.m_active.items().empty())
+            return false;
+        checkheader_type h;
+        memcpy(h.magic, "ZPETRICP", 8);
+        h.version = version;
+        h.byteorder = byteorder();
+        h.places = net.pl_num();
+        h.reserved = 0;
+        h.fingerprint = fingerprint(net);
+
+        std::string temp = std::string(filename) + ".tmp";
+        FILE *file = fopen(temp.c_str(), "wb");
+        if (!file)
+            return false;
+        bool ok = fwrite(&h, sizeof(h), 1, file) == 1 &&
+            put(file, net.m_marking);
+        ok = (fclose(file) == 0) && ok && replace(temp, filename);
+        if (!ok)
+            std::remove(temp.c_str());
+        return ok;
+    }
+    //     
+    // (     ,    ,
+    //      )
+    static
+    bool restore(const char *filename, transition_compound_type &net)
+    {
+        if (!net.m_active.items().empty())
+            return false;
+        FILE *file = fopen(filename, "rb");
+        if (!file)
+            return false;
+        checkheader_type h;
+        std::vector<int> marking(net.pl_num());
+        bool ok = fread(&h, sizeof(h), 1, file) == 1 &&
+            memcmp(h.magic, "ZPETRICP", 8) == 0 &&
+            h.version == version && h.byteorder == byteorder() &&
+            int(h.places) == net.pl_num() &&
+            h.fingerprint == fingerprint(net) &&
+            (marking.empty() || fread(&marking[0], sizeof(int),
+                marking.size(), file) == marking.size());
+        fclose(file);
+        for (size_t j = 0; ok && j < marking.size(); ++j)
+            ok = marking[j] >= 0;
+        if (ok)
+            net.restore(marking);
+        return ok;
+    }
+};
+
+} // namespace petri
+} // namespace z
+
+#endif /* _ZPETRI_SNAPSHOT_HXX_ */
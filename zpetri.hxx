@@ -24,6 +24,8 @@
 #include <vector>
 #include <map>
 #include <iterator>
+#include <algorithm>
+#include <utility>
 #include <cassert>
 
 namespace z {
@@ -32,14 +34,105 @@ namespace petri {
 //     
 class place_type {};
 
+//     [0, n)    
+//         
+class indexset_type
+{
+private:
+    //     
+    std::vector<int> m_items;
+    //     m_items (-1,   )
+    std::vector<int> m_pos;
+
+public:
+    //      
+    void reset(int n)
+    {
+        m_items.clear();
+        m_items.reserve(n);
+        m_pos.assign(n, -1);
+    }
+    //    
+    void assign(int i, bool include)
+    {
+        if (include && m_pos[i] < 0)
+        {
+            m_pos[i] = m_items.size();
+            m_items.push_back(i);
+        }
+        else if (!include && m_pos[i] >= 0)
+        {
+            m_pos[m_items.back()] = m_pos[i];
+            m_items[m_pos[i]] = m_items.back();
+            m_items.pop_back();
+            m_pos[i] = -1;
+        };
+    }
+    bool contains(int i) const
+    {
+        return m_pos[i] >= 0;
+    }
+    const std::vector<int> &items(void) const
+    {
+        return m_items;
+    }
+};
+
+class transition_abstract_type;
+
+//    :  
+//      
+class marking_abstract_type
+{
+public:
+    //   
+    typedef std::map<place_type *, int> markedlist_type;
+
+    //     
+    // (    )
+    //     
+    virtual
+    markedlist_type get_marked(void) const = 0;
+    //     
+    // (0,          )
+    virtual
+    int get_tokens(place_type *pl) const = 0;
+    //      
+    // (-1,          )
+    virtual
+    int locate(const transition_abstract_type *) const
+    { return -1; }
+};
+
 //   
-class transition_abstract_type
+class transition_abstract_type: public marking_abstract_type
 {
+private:
+    //   
+    const void *m_tag;
+
+protected:
+    //    :  , 
+    //    (,   ),
+    //    ,    ,
+    //   
+    void set_tag(const void *tag)
+    {
+        m_tag = tag;
+    }
+
 public:
     //   
     typedef std::vector<transition_abstract_type *> enabledlist_type;
-    //   
-    typedef std::map<place_type *, int> markedlist_type;
+
+    transition_abstract_type(): m_tag(0) {}
+
+    //    ,   
+    //   dynamic_cast (0 -    )
+    const void *tag(void) const
+    {
+        return m_tag;
+    }
 
     //  
     virtual
@@ -50,15 +143,21 @@ public:
     //     
     // (    )
     virtual
-    enabledlist_type get_enabled(void) const = 0;
-    //     
-    // (    )
-    virtual
-    markedlist_type get_marked(void) const = 0;
+    const enabledlist_type &get_enabled(void) const = 0;
     //      
     // (    )
     virtual
     void fire(int number) = 0;
+    //      
+    //  :     ,
+    //     (   
+    //  )
+    virtual
+    void get_change(int &head, int &tail) const
+    {
+        head = 0;
+        tail = 0;
+    }
 
     //  
     virtual
@@ -75,39 +174,174 @@ public:
     {}
     bool is_active(void) const
     { return false; }
-    enabledlist_type get_enabled(void) const
-    { return enabledlist_type(); }
+    const enabledlist_type &get_enabled(void) const
+    { static const enabledlist_type empty; return empty; }
     markedlist_type get_marked(void) const
     { return markedlist_type(); }
+    int get_tokens(place_type *) const
+    { return 0; }
     void fire(int)
     { assert(false); }
 };
 
+//      
+// (   )
+class enabledview_type
+{
+public:
+    typedef transition_abstract_type *const *const_iterator;
+
+private:
+    const_iterator m_begin;
+    int m_size;
+    //      (0,   )
+    const marking_abstract_type *m_source;
+
+public:
+    explicit
+    enabledview_type(const transition_abstract_type::enabledlist_type &list):
+        m_begin(list.empty() ? 0 : &list[0]), m_size(list.size()),
+        m_source(0)
+    {}
+    enabledview_type(
+        const transition_abstract_type::enabledlist_type &list,
+        const marking_abstract_type &source):
+        m_begin(list.empty() ? 0 : &list[0]), m_size(list.size()),
+        m_source(&source)
+    {}
+    int size(void) const
+    { return m_size; }
+    bool empty(void) const
+    { return m_size == 0; }
+    transition_abstract_type *operator [](int i) const
+    { return m_begin[i]; }
+    const_iterator begin(void) const
+    { return m_begin; }
+    const_iterator end(void) const
+    { return m_begin + m_size; }
+    //     (-1,    ): 
+    //    ,    , 
+    int find(const transition_abstract_type *tr) const
+    {
+        if (m_source)
+            return m_source->locate(tr);
+        const_iterator it = std::find(begin(), end(), tr);
+        return (it != end()) ? int(it - begin()) : -1;
+    }
+};
+
+//       
+// (   )
+class markedview_type
+{
+private:
+    const marking_abstract_type *m_source;
+
+public:
+    explicit
+    markedview_type(const marking_abstract_type &source):
+        m_source(&source)
+    {}
+    //    
+    int operator [](place_type *pl) const
+    { return m_source->get_tokens(pl); }
+    //     (   )
+    marking_abstract_type::markedlist_type get_list(void) const
+    { return m_source->get_marked(); }
+};
+
+class flatnet_type;
+class snapshot_type;
+
 //   (  )
 class transition_compound_type: public transition_abstract_type
 {
+    //     
+    friend class flatnet_type;
+    //     
+    friend class snapshot_type;
+
 private:
     typedef std::vector<place_type *> placelist_type;
     typedef std::vector<transition_abstract_type *> transitionlist_type;
     typedef std::vector<int> marking_type;
-    typedef std::vector<marking_type> arcmatrix_type;
+
+    //        (CSR):
+    //    i   index  weight
+    //   [start[i], start[i + 1])    
+    struct arcmatrix_type
+    {
+        std::vector<int> start;
+        std::vector<int> index;
+        std::vector<int> weight;
+    };
+
+    //       
+    // (      )
+    static
+    arcmatrix_type transpose(const arcmatrix_type &mtx, int cols)
+    {
+        arcmatrix_type res;
+        //      
+        res.start.assign(cols + 1, 0);
+        std::vector<int>::const_iterator it;
+        for (it = mtx.index.begin(); it != mtx.index.end(); ++it)
+            ++res.start[*it + 1];
+        for (int j = 0; j < cols; ++j)
+            res.start[j + 1] += res.start[j];
+        //    
+        res.index.resize(mtx.index.size());
+        res.weight.resize(mtx.weight.size());
+        std::vector<int> pos(res.start.begin(), res.start.end() - 1);
+        for (int i = 0; i + 1 < int(mtx.start.size()); ++i)
+        {
+            for (int k = mtx.start[i]; k < mtx.start[i + 1]; ++k)
+            {
+                int p = pos[mtx.index[k]]++;
+                res.index[p] = i;
+                res.weight[p] = mtx.weight[k];
+            };
+        };
+        return res;
+    }
 
 public:
+    //      (, 
+    //     ):    , 
+    //          
+    //   CSR,  
+    struct image_type
+    {
+        int places, transitions;
+        place_type *const *pllist;
+        transition_abstract_type *const *trlist;
+        const int *instart, *inindex, *inweight;
+        const int *outstart, *outindex, *outweight;
+        const int *consstart, *consindex, *consweight;
+        const int *marking;
+    };
+
     //   
     class content_type
     {
     private:
         typedef std::map<place_type *, int> plmap_type;
         typedef std::map<transition_abstract_type *, int> trmap_type;
-        typedef std::map<std::pair<int, int>, int> arcmap_type;
         typedef std::map<int, int> tokmap_type;
 
+        // :  ,    
+        struct arc_type
+        {
+            int tr, pl, weight;
+        };
+        typedef std::vector<arc_type> arclist_type;
+
         //     
         plmap_type m_plmap;
         //     
         trmap_type m_trmap;
-        //        
-        arcmap_type m_inmap, m_outmap;
+        //        
+        arclist_type m_inarcs, m_outarcs;
         //      
         tokmap_type m_tokmap;
 
@@ -117,33 +351,60 @@ public:
             place_type &pl,
             transition_abstract_type &tr,
             int weight,
-            arcmap_type &arcmap)
+            arclist_type &arcs)
         {
-            assert(m_plmap.find(&pl) != m_plmap.end());
-            assert(m_trmap.find(&tr) != m_trmap.end());
+            plmap_type::const_iterator pt = m_plmap.find(&pl);
+            trmap_type::const_iterator tt = m_trmap.find(&tr);
+            assert(pt != m_plmap.end());
+            assert(tt != m_trmap.end());
             assert(weight > 0);
-            arcmap_type::key_type arc(m_trmap[&tr], m_plmap[&pl]);
-            arcmap[arc] += weight;
+            arc_type arc = { tt->second, pt->second, weight };
+            arcs.push_back(arc);
         }
-        //    
-        arcmatrix_type build_matrix(const arcmap_type &arcmap) const
+        //       
+        arcmatrix_type build_matrix(const arclist_type &arcs) const
         {
-            arcmatrix_type mtx(m_trmap.size());
-            arcmatrix_type::iterator it;
-            for (it = mtx.begin(); it != mtx.end(); ++it)
+            int trnum = m_trmap.size(), plnum = m_plmap.size();
+            //       
+            arcmatrix_type mtx;
+            mtx.start.assign(trnum + 1, 0);
+            arclist_type::const_iterator it;
+            for (it = arcs.begin(); it != arcs.end(); ++it)
+                ++mtx.start[it->tr + 1];
+            for (int i = 0; i < trnum; ++i)
+                mtx.start[i + 1] += mtx.start[i];
+            mtx.index.resize(arcs.size());
+            mtx.weight.resize(arcs.size());
+            std::vector<int> pos(mtx.start.begin(), mtx.start.end() - 1);
+            for (it = arcs.begin(); it != arcs.end(); ++it)
+            {
+                int p = pos[it->tr]++;
+                mtx.index[p] = it->pl;
+                mtx.weight[p] = it->weight;
+            };
+            //      
+            mtx = transpose(transpose(mtx, plnum), trnum);
+            //   ,   
+            int n = 0;
+            for (int i = 0; i < trnum; ++i)
             {
-                arcmatrix_type::value_type vec(m_plmap.size());
-                arcmatrix_type::value_type::iterator jt;
-                for (jt = vec.begin(); jt != vec.end(); ++jt)
+                int first = mtx.start[i], last = mtx.start[i + 1];
+                mtx.start[i] = n;
+                for (int k = first; k < last; ++k)
                 {
-                    arcmap_type::const_iterator ft;
-                    ft = arcmap.find(arcmap_type::key_type(
-                        std::distance(mtx.begin(), it),
-                        std::distance(vec.begin(), jt)));
-                    *jt = (ft != arcmap.end()) ? ft->second : 0;
+                    if (n > mtx.start[i] && mtx.index[n - 1] == mtx.index[k])
+                        mtx.weight[n - 1] += mtx.weight[k];
+                    else
+                    {
+                        mtx.index[n] = mtx.index[k];
+                        mtx.weight[n] = mtx.weight[k];
+                        ++n;
+                    };
                 };
-                *it = vec;
             };
+            mtx.start[trnum] = n;
+            mtx.index.resize(n);
+            mtx.weight.resize(n);
             return mtx;
         }
 
@@ -171,7 +432,7 @@ public:
             transition_abstract_type &tr,
             int weight = 1)
         {
-            add_arc(in, tr, weight, m_inmap);
+            add_arc(in, tr, weight, m_inarcs);
         }
         //   
         void add_arc(
@@ -179,7 +440,7 @@ public:
             place_type &out,
             int weight = 1)
         {
-            add_arc(out, tr, weight, m_outmap);
+            add_arc(out, tr, weight, m_outarcs);
         }
 
         //      
@@ -216,11 +477,11 @@ public:
         //      
         arcmatrix_type get_inmatrix(void) const
         {
-            return build_matrix(m_inmap);
+            return build_matrix(m_inarcs);
         }
         arcmatrix_type get_outmatrix(void) const
         {
-            return build_matrix(m_outmap);
+            return build_matrix(m_outarcs);
         }
 
         //   
@@ -235,152 +496,604 @@ public:
     };
 
 private:
-    //  
-    placelist_type m_pllist;
-    //  
-    transitionlist_type m_trlist;
-    //     
-    arcmatrix_type m_mtxin;
-    arcmatrix_type m_mtxout;
-    //  
-    marking_type m_marking_init;
+    //   :   , 
+    //  ,   (,    
+    // )  ,    -   ;
+    //        view
+    class arrays_type
+    {
+    private:
+        //   (  ,   )
+        placelist_type m_pllist;
+        transitionlist_type m_trlist;
+        arcmatrix_type m_mtxin, m_mtxout, m_consumers;
+        marking_type m_marking;
+        bool m_owner;
+        //  
+        image_type m_view;
+
+        template <class T>
+        static
+        const T *first(const std::vector<T> &v)
+        {
+            return v.empty() ? 0 : &v[0];
+        }
+        //     
+        void bind(void)
+        {
+            m_view.places = m_pllist.size();
+            m_view.transitions = m_trlist.size();
+            m_view.pllist = first(m_pllist);
+            m_view.trlist = first(m_trlist);
+            m_view.instart = first(m_mtxin.start);
+            m_view.inindex = first(m_mtxin.index);
+            m_view.inweight = first(m_mtxin.weight);
+            m_view.outstart = first(m_mtxout.start);
+            m_view.outindex = first(m_mtxout.index);
+            m_view.outweight = first(m_mtxout.weight);
+            m_view.consstart = first(m_consumers.start);
+            m_view.consindex = first(m_consumers.index);
+            m_view.consweight = first(m_consumers.weight);
+            m_view.marking = first(m_marking);
+        }
+
+    public:
+        explicit
+        arrays_type(const content_type &content):
+            m_pllist(content.get_pllist()),
+            m_trlist(content.get_trlist()),
+            m_mtxin(content.get_inmatrix()),
+            m_mtxout(content.get_outmatrix()),
+            m_consumers(transpose(m_mtxin, m_pllist.size())),
+            m_marking(content.get_marking()),
+            m_owner(true)
+        {
+            bind();
+        }
+        explicit
+        arrays_type(const image_type &image):
+            m_owner(false), m_view(image)
+        {}
+        //     
+        //     
+        arrays_type(const arrays_type &other):
+            m_pllist(other.m_pllist),
+            m_trlist(other.m_trlist),
+            m_mtxin(other.m_mtxin),
+            m_mtxout(other.m_mtxout),
+            m_consumers(other.m_consumers),
+            m_marking(other.m_marking),
+            m_owner(other.m_owner),
+            m_view(other.m_view)
+        {
+            if (m_owner)
+                bind();
+        }
+        arrays_type &operator =(const arrays_type &other)
+        {
+            m_pllist = other.m_pllist;
+            m_trlist = other.m_trlist;
+            m_mtxin = other.m_mtxin;
+            m_mtxout = other.m_mtxout;
+            m_consumers = other.m_consumers;
+            m_marking = other.m_marking;
+            m_owner = other.m_owner;
+            m_view = other.m_view;
+            if (m_owner)
+                bind();
+            return *this;
+        }
+
+        const image_type &view(void) const
+        {
+            return m_view;
+        }
+    };
+
+    //    ,     ,
+    //     ( ,
+    //     )   
+    arrays_type m_arrays;
+
+    //          
+    // (  ,    get_tokens  locate)
+    std::vector<std::pair<const place_type *, int> > m_plindex;
+    std::vector<std::pair<const transition_abstract_type *, int> > m_trindex;
 
     //  
     marking_type m_marking;
-    //    ,  
-    markedlist_type m_marked;
+    //  ,  
+    indexset_type m_marked;
+    //   
+    indexset_type m_active;
     //    ,  
     enabledlist_type m_enabled;
-    //   m_enabled   
-    std::vector<int> m_location;
-    //   m_enabled    
-    std::vector<int> m_offset;
+    //       m_enabled
+    std::vector<int> m_areasize;
+    //     m_areasize
+    // (         m_enabled)
+    std::vector<int> m_areatree;
+    //      m_enabled,
+    //    ( ) 
+    int m_head, m_tail;
+
+    typedef transition_abstract_type *const *const_pointer;
+    //      m_enabled
+    struct change_type
+    {
+        int local, pos, removed;
+        const_pointer first, last;
+    };
+    //     
+    std::vector<change_type> m_changes;
+    //       
+    std::vector<int> m_recheck;
+    //    m_enabled
+    enabledlist_type m_buffer;
 
+    //   ,   
+    //   
+    std::vector<int> m_touched;
+
+    //  
+    const image_type &net(void) const
+    {
+        return m_arrays.view();
+    }
     //   
     int pl_num(void) const
     {
-        return m_pllist.size();
+        return net().places;
     }
     //   
     int tr_num(void) const
     {
-        return m_trlist.size();
+        return net().transitions;
     }
 
-    //       
-    void refresh(void)
+    //       
+    void build_index(void)
+    {
+        m_plindex.resize(pl_num());
+        for (int j = 0; j < pl_num(); ++j)
+            m_plindex[j] = std::make_pair(net().pllist[j], j);
+        std::sort(m_plindex.begin(), m_plindex.end());
+        m_trindex.resize(tr_num());
+        for (int i = 0; i < tr_num(); ++i)
+            m_trindex[i] = std::make_pair(net().trlist[i], i);
+        std::sort(m_trindex.begin(), m_trindex.end());
+    }
+    //      (-1,    )
+    template <class T>
+    static
+    int find_index(const std::vector<std::pair<const T *, int> > &index,
+        const T *object)
+    {
+        typename std::vector<std::pair<const T *, int> >::const_iterator it =
+            std::lower_bound(index.begin(), index.end(),
+                std::make_pair(object, 0));
+        return (it != index.end() && it->first == object) ? it->second : -1;
+    }
+
+    //     
+    void rescan(
+        enabledlist_type &enabled,
+        std::vector<int> &areasize) const
     {
         //       
-        m_enabled.clear();
-        m_location.clear();
-        m_offset.resize(tr_num());
+        enabled.clear();
+        areasize.resize(tr_num());
         for (int i = 0; i < tr_num(); ++i)
         {
-            //   m_enabled  i-  
-            m_offset[i] = m_enabled.size();
+            //   enabled  i-  
+            int offset = enabled.size();
 
             //   
-            if (m_trlist[i]->is_active())
+            if (net().trlist[i]->is_active())
             {
                 //    
-                enabledlist_type inner = m_trlist[i]->get_enabled();
+                const enabledlist_type &inner = net().trlist[i]->get_enabled();
                 //      
-                m_enabled.insert(
-                    m_enabled.end(), inner.begin(), inner.end());
-                //     i-  
-                m_location.insert(m_location.end(), inner.size(), i);
+                enabled.insert(enabled.end(), inner.begin(), inner.end());
             }
-            else
-            {
-                //   , ,  
-                bool isenabled = true;
-                for (int j = 0; isenabled && j < pl_num(); ++j)
-                    isenabled = (m_marking[j] >= m_mtxin[i][j]);
-                //   ,  
-                if (isenabled)
-                {
-                    m_enabled.push_back(m_trlist[i]);
-                    m_location.push_back(i);
-                };
-            };
+            //   ,  ,  
+            else if (is_enabled(i))
+                enabled.push_back(net().trlist[i]);
+            areasize[i] = enabled.size() - offset;
         };
+    }
 
-        //    
-        m_marked.clear();
-        //  
+    //    ,  
+    //   
+    void refresh(void)
+    {
+        rescan(m_enabled, m_areasize);
+        m_head = m_tail = 0;
+        m_marked.reset(pl_num());
+        for (int j = 0; j < pl_num(); ++j)
+            m_marked.assign(j, m_marking[j] > 0);
+        m_active.reset(tr_num());
+        for (int i = 0; i < tr_num(); ++i)
+            m_active.assign(i, net().trlist[i]->is_active());
+        //       
+        m_areatree.assign(tr_num() + 1, 0);
+        for (int k = 1; k <= tr_num(); ++k)
+        {
+            m_areatree[k] += m_areasize[k - 1];
+            int parent = k + (k & -k);
+            if (parent <= tr_num())
+                m_areatree[parent] += m_areatree[k];
+        };
+    }
+
+    //     
+    //    
+    bool is_consistent(void) const
+    {
+        enabledlist_type enabled;
+        std::vector<int> areasize;
+        rescan(enabled, areasize);
+        if (enabled != m_enabled || areasize != m_areasize)
+            return false;
         for (int j = 0; j < pl_num(); ++j)
-            if (m_marking[j] > 0)
-                m_marked[m_pllist[j]] = m_marking[j];
-        //     
+            if (m_marked.contains(j) != (m_marking[j] > 0))
+                return false;
         for (int i = 0; i < tr_num(); ++i)
+            if (m_active.contains(i) != net().trlist[i]->is_active())
+                return false;
+        return true;
+    }
+
+    // ,     
+    bool is_enabled(int i) const
+    {
+        const image_type &a = net();
+        for (int k = a.instart[i]; k < a.instart[i + 1]; ++k)
+            if (m_marking[a.inindex[k]] < a.inweight[k])
+                return false;
+        return true;
+    }
+
+    //   i-    m_enabled
+    int area_offset(int i) const
+    {
+        int offset = 0;
+        for (int k = i; k > 0; k -= k & -k)
+            offset += m_areatree[k];
+        return offset;
+    }
+    //   ,    
+    //  m_enabled   number,     
+    int area_locate(int number, int &lower) const
+    {
+        int step = 1;
+        while (step * 2 <= tr_num())
+            step *= 2;
+        int i = 0;
+        for (; step > 0; step /= 2)
         {
-            if (m_trlist[i]->is_active())
+            if (i + step <= tr_num() && m_areatree[i + step] <= number)
             {
-                markedlist_type inner = m_trlist[i]->get_marked();
-                m_marked.insert(inner.begin(), inner.end());
+                i += step;
+                number -= m_areatree[i];
             };
         };
+        lower = number;
+        return i;
+    }
+
+    //  removed  m_enabled,    offset,
+    //  [first, last);     
+    // ,     
+    void splice(
+        int offset,
+        int removed,
+        const_pointer first,
+        const_pointer last)
+    {
+        int inserted = last - first;
+        enabledlist_type::iterator it = m_enabled.begin() + offset;
+        //       
+        int common = std::min(removed, inserted);
+        std::copy(first, first + common, it);
+        //    
+        if (inserted > removed)
+            m_enabled.insert(it + common, first + common, last);
+        else if (inserted < removed)
+            m_enabled.erase(it + common, it + removed);
+        //    
+        m_head = std::min(m_head, offset);
+        m_tail = std::min(m_tail, int(m_enabled.size()) - offset - inserted);
+    }
+
+    //     i-  
+    //    
+    void resize_area(int i, int delta)
+    {
+        if (delta == 0)
+            return;
+        m_areasize[i] += delta;
+        for (int k = i + 1; k <= tr_num(); k += k & -k)
+            m_areatree[k] += delta;
+    }
+    //    i-  :
+    // removed ,    pos  ,
+    //   [first, last)
+    void splice_area(
+        int i,
+        int pos,
+        int removed,
+        const_pointer first,
+        const_pointer last)
+    {
+        splice(area_offset(i) + pos, removed, first, last);
+        resize_area(i, int(last - first) - removed);
+    }
+
+    //    i-  
+    //      (   splice_area)
+    void add_change(
+        int i,
+        int pos,
+        int removed,
+        const_pointer first,
+        const_pointer last)
+    {
+        change_type change = { i, pos, removed, first, last };
+        m_changes.push_back(change);
+    }
+    static
+    bool change_less(const change_type &a, const change_type &b)
+    {
+        return a.local < b.local;
+    }
+
+    //    :  
+    //   m_enabled      
+    //  ,       
+    void apply_changes(void)
+    {
+        if (m_changes.empty())
+            return;
+        if (m_changes.size() == 1)
+        {
+            const change_type &c = m_changes[0];
+            splice_area(c.local, c.pos, c.removed, c.first, c.last);
+            m_changes.clear();
+            return;
+        };
+        //      
+        std::sort(m_changes.begin(), m_changes.end(), change_less);
+        int first = area_offset(m_changes[0].local) + m_changes[0].pos;
+        int last = first;
+        m_buffer.clear();
+        std::vector<change_type>::const_iterator it;
+        for (it = m_changes.begin(); it != m_changes.end(); ++it)
+        {
+            int offset = area_offset(it->local) + it->pos;
+            m_buffer.insert(m_buffer.end(),
+                m_enabled.begin() + last, m_enabled.begin() + offset);
+            m_buffer.insert(m_buffer.end(), it->first, it->last);
+            last = offset + it->removed;
+        };
+        const_pointer begin = m_buffer.empty() ? 0 : &m_buffer[0];
+        splice(first, last - first, begin, begin + m_buffer.size());
+        //        
+        for (it = m_changes.begin(); it != m_changes.end(); ++it)
+            resize_area(it->local, int(it->last - it->first) - it->removed);
+        m_changes.clear();
+    }
+
+    //     ,
+    //        
+    void recheck_local(int i)
+    {
+        const_pointer self = &net().trlist[i];
+        int size = is_enabled(i) ? 1 : 0;
+        if (size != m_areasize[i])
+            add_change(i, 0, m_areasize[i], self, self + size);
+    }
+
+    //    
+    void change_marking(int j, int delta)
+    {
+        m_marking[j] += delta;
+        m_marked.assign(j, m_marking[j] > 0);
+        m_touched.push_back(j);
     }
 
 public:
     explicit
     transition_compound_type(const content_type &content):
-        m_pllist(content.get_pllist()),
-        m_trlist(content.get_trlist()),
-        m_mtxin(content.get_inmatrix()),
-        m_mtxout(content.get_outmatrix()),
-        m_marking_init(content.get_marking())
-    {}
+        m_arrays(content), m_head(0), m_tail(0)
+    {
+        build_index();
+    }
+    //    :   ,  
+    //  ,   
+    explicit
+    transition_compound_type(const image_type &image):
+        m_arrays(image), m_head(0), m_tail(0)
+    {
+        build_index();
+    }
 
     void activate(void)
     {
-        m_marking = m_marking_init;
+        m_marking.assign(net().marking, net().marking + pl_num());
         refresh();
     }
     bool is_active(void) const
     {
         return !m_enabled.empty();
     }
-    enabledlist_type get_enabled(void) const
+    const enabledlist_type &get_enabled(void) const
     {
         return m_enabled;
     }
+    void get_change(int &head, int &tail) const
+    {
+        head = m_head;
+        tail = std::min(m_tail, int(m_enabled.size()) - m_head);
+    }
     markedlist_type get_marked(void) const
     {
-        return m_marked;
+        //  
+        markedlist_type marked;
+        std::vector<int>::const_iterator it;
+        for (it = m_marked.items().begin(); it != m_marked.items().end(); ++it)
+            marked[net().pllist[*it]] = m_marking[*it];
+        //     
+        for (it = m_active.items().begin(); it != m_active.items().end(); ++it)
+        {
+            markedlist_type inner = net().trlist[*it]->get_marked();
+            marked.insert(inner.begin(), inner.end());
+        };
+        return marked;
+    }
+    int get_tokens(place_type *pl) const
+    {
+        int j = find_index(m_plindex, (const place_type *)pl);
+        if (j >= 0)
+            return m_marking[j];
+        std::vector<int>::const_iterator it;
+        for (it = m_active.items().begin(); it != m_active.items().end(); ++it)
+        {
+            int tokens = net().trlist[*it]->get_tokens(pl);
+            if (tokens > 0)
+                return tokens;
+        };
+        return 0;
+    }
+    int locate(const transition_abstract_type *tr) const
+    {
+        //       
+        int i = find_index(m_trindex, tr);
+        if (i >= 0)
+            return (!m_active.contains(i) && m_areasize[i] == 1) ?
+                area_offset(i) : -1;
+        //        
+        std::vector<int>::const_iterator it;
+        for (it = m_active.items().begin(); it != m_active.items().end(); ++it)
+        {
+            int inner = net().trlist[*it]->locate(tr);
+            if (inner >= 0)
+                return area_offset(*it) + inner;
+        };
+        return -1;
+    }
+
+    // -------   -------
+
+    //     (   )
+    const std::vector<int> &get_marking(void) const
+    {
+        return m_marking;
+    }
+    //     
+    // (    :     
+    //  -       )
+    void restore(const std::vector<int> &marking)
+    {
+        assert(int(marking.size()) == pl_num());
+        assert(m_active.items().empty());
+        m_marking = marking;
+        refresh();
     }
+
     void fire(int number)
     {
         assert(number >= 0 && size_t(number) < m_enabled.size());
 
-        //      
-        int local = m_location[number];
-        //    (   )
-        int lower = number - m_offset[local];
+        //   ,   ,
+        //    (   )
+        int lower;
+        int local = area_locate(number, lower);
+        const image_type &a = net();
+        transition_abstract_type &tr = *a.trlist[local];
 
-        //   ,  
-        if (m_trlist[local]->is_active())
-            m_trlist[local]->fire(lower);
+        m_touched.clear();
+        m_head = m_tail = m_enabled.size();
+        //   ,  
+        bool wasactive = tr.is_active();
+        if (wasactive)
+            tr.fire(lower);
         else
         {
-            //    
-            for (int j = 0; j < pl_num(); ++j)
-                m_marking[j] -= m_mtxin[local][j];
-            //  
-            m_trlist[local]->on_activate();
-            m_trlist[local]->activate();
+            //    
+            for (int k = a.instart[local]; k < a.instart[local + 1]; ++k)
+                change_marking(a.inindex[k], -a.inweight[k]);
+            //  
+            tr.on_activate();
+            tr.activate();
         };
         //     
-        if (!m_trlist[local]->is_active())
+        if (!tr.is_active())
         {
-            m_trlist[local]->on_passivate();
-            //   
-            for (int j = 0; j < pl_num(); ++j)
-                m_marking[j] += m_mtxout[local][j];
+            tr.on_passivate();
+            //   
+            for (int k = a.outstart[local]; k < a.outstart[local + 1]; ++k)
+                change_marking(a.outindex[k], a.outweight[k]);
         };
 
-        //  
-        refresh();
+        //    
+        m_active.assign(local, tr.is_active());
+        if (tr.is_active())
+        {
+            //    ,   
+            //    ,  -  
+            const enabledlist_type &inner = tr.get_enabled();
+            int head = 0, tail = 0;
+            if (wasactive)
+                tr.get_change(head, tail);
+            assert(head + tail <= m_areasize[local]);
+            const_pointer begin = inner.empty() ? 0 : &inner[0];
+            int removed = m_areasize[local] - head - tail;
+            //     ,  
+            //  ,     
+            if (m_touched.empty())
+                splice_area(local, head, removed,
+                    begin + head, begin + inner.size() - tail);
+            else
+                add_change(local, head, removed,
+                    begin + head, begin + inner.size() - tail);
+        }
+        else if (wasactive)
+        {
+            //    
+            const_pointer self = &a.trlist[local];
+            int size = is_enabled(local) ? 1 : 0;
+            add_change(local, 0, m_areasize[local], self, self + size);
+        }
+        else
+            m_recheck.push_back(local);
+        //   ,    
+        std::vector<int>::const_iterator jt;
+        for (jt = m_touched.begin(); jt != m_touched.end(); ++jt)
+        {
+            for (int k = a.consstart[*jt]; k < a.consstart[*jt + 1]; ++k)
+            {
+                int i = a.consindex[k];
+                if (i != local && !a.trlist[i]->is_active())
+                    m_recheck.push_back(i);
+            };
+        };
+        if (m_recheck.size() > 1)
+        {
+            std::sort(m_recheck.begin(), m_recheck.end());
+            m_recheck.erase(std::unique(m_recheck.begin(), m_recheck.end()),
+                m_recheck.end());
+        };
+        for (jt = m_recheck.begin(); jt != m_recheck.end(); ++jt)
+            recheck_local(*jt);
+        m_recheck.clear();
+        //        
+        apply_changes();
+
+#ifdef ZPETRI_CHECK_INCREMENTAL
+        //    
+        assert(is_consistent());
+#endif
     }
 };
 
@@ -399,17 +1112,91 @@ public:
             const enabledlist_type &enabled,
             const markedlist_type &marked) = 0;
     };
+    //   ,     
+    class environment_view_abstract_type
+    {
+    public:
+        //     
+        //     
+        //   ,   
+        virtual
+        int wait(
+            const enabledview_type &enabled,
+            const markedview_type &marked) = 0;
+    };
+
+    //       
+    class monitor_abstract_type
+    {
+    public:
+        //     
+        virtual
+        void on_wait_begin(void) {}
+        virtual
+        void on_wait_end(void) {}
+        //      
+        virtual
+        void on_fire(transition_abstract_type *) {}
+    };
+
+private:
+    //   (0,   )
+    monitor_abstract_type *m_monitor;
+
+    //       
+    void step(int number)
+    {
+        if (m_monitor)
+        {
+            m_monitor->on_wait_end();
+            m_monitor->on_fire(get_enabled()[number]);
+        };
+        fire(number);
+    }
 
 public:
     petrinet_type(const content_type &content):
-        transition_compound_type(content)
+        transition_compound_type(content), m_monitor(0)
     {}
+    petrinet_type(const image_type &image):
+        transition_compound_type(image), m_monitor(0)
+    {}
+    //   (0 - )
+    void set_monitor(monitor_abstract_type *monitor)
+    {
+        m_monitor = monitor;
+    }
     //     
     void live(environment_abstract_type &env)
     {
         activate();
+        resume(env);
+    }
+    void live(environment_view_abstract_type &env)
+    {
+        activate();
+        resume(env);
+    }
+    //      
+    // (,    )
+    void resume(environment_abstract_type &env)
+    {
         while (is_active())
-            fire(env.wait(get_enabled(), get_marked()));
+        {
+            if (m_monitor)
+                m_monitor->on_wait_begin();
+            step(env.wait(get_enabled(), get_marked()));
+        };
+    }
+    void resume(environment_view_abstract_type &env)
+    {
+        while (is_active())
+        {
+            if (m_monitor)
+                m_monitor->on_wait_begin();
+            step(env.wait(enabledview_type(get_enabled(), *this),
+                markedview_type(*this)));
+        };
     }
 };
 